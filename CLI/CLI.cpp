@@ -11,17 +11,62 @@ int main(const int argc, char* argv[])
 {
 	try
 	{
-		if (argc < 2)
+		std::vector<std::string> arguments;
+		std::string translation_file_name;
+		std::string native_module_name;
+		auto engine = dispatch_engine::switch_loop;
+		auto use_image_cache = false;
+		auto threads = thread_model::os_threads;
+		auto map_binary_file = false;
+		auto interactive_console = false;
+		for (auto i = 1; i < argc; i++)
+			if (std::string(argv[i]) == "--threaded")
+				engine = dispatch_engine::threaded;
+			else if (std::string(argv[i]) == "--jit")
+				engine = dispatch_engine::jit;
+			else if (std::string(argv[i]) == "--tasks")
+				threads = thread_model::tasks;
+			else if (std::string(argv[i]) == "--interactive")
+				interactive_console = true;
+			else if (std::string(argv[i]) == "--mmap")
+				map_binary_file = true;
+			else if (std::string(argv[i]) == "--evmc")
+				use_image_cache = true;
+			else if (std::string(argv[i]) == "--evm2c" && i + 1 < argc)
+				translation_file_name = argv[++i];
+			else if (std::string(argv[i]) == "--native" && i + 1 < argc)
+				native_module_name = argv[++i];
+			else
+				arguments.emplace_back(argv[i]);
+
+		if (arguments.empty())
 		{
 			show_usage();
 			return 0;
 		}
 		setup();
 		
-		process = process::factory::create(argv[1]);
+		process = process::factory::create(arguments[0], use_image_cache);
+		process->engine = engine;
+		process->threads = threads;
+
+		if (!translation_file_name.empty())
+		{
+			std::ofstream translation(translation_file_name);
+			aot_translator::factory::create(process->code)->translate(translation);
+			if (!translation)
+				throw std::runtime_error("Can't write " + translation_file_name);
+			process.reset();
+			return 0;
+		}
+
+		if (!native_module_name.empty())
+			process->native = aot_module::factory::create(native_module_name, process->code);
 		
-		if (argc > 2)
-			process->binary_file_name = argv[2];
+		if (arguments.size() > 1)
+			process->binary_file_name = arguments[1];
+		process->map_binary_file = map_binary_file;
+		process->interactive_console = interactive_console;
 
 		process->start();
 		
@@ -52,7 +97,18 @@ int main(const int argc, char* argv[])
 
 void show_usage()
 {
-	std::cout << "Usage: evm2.exe program.evm [file.bin]" << std::endl;
+	std::cout << "Usage: evm2.exe [--threaded | --jit] [--native module] [--tasks] [--mmap] [--interactive] [--evmc] program.evm [file.bin]" << std::endl;
+	std::cout << "       evm2.exe --evm2c program.cpp program.evm" << std::endl;
+	std::cout << "  --threaded  run with the direct threaded engine" << std::endl;
+	std::cout << "  --jit       run with the threaded engine and translate hot blocks to x86-64" << std::endl;
+	std::cout << "  --tasks     run guest threads as tasks on a pool of worker threads" << std::endl;
+	std::cout << "  --interactive" << std::endl;
+	std::cout << "              write console output after every value instead of in batches" << std::endl;
+	std::cout << "  --mmap      map [file.bin] into memory instead of reading and writing it per instruction" << std::endl;
+	std::cout << "  --evmc      keep pre-decoded code in program.evmc and load it from there on later starts" << std::endl;
+	std::cout << "  --evm2c     translate the program to C++ source instead of running it" << std::endl;
+	std::cout << "  --native    run with the module built from that source," << std::endl;
+	std::cout << "              e.g. cl /O2 /LD program.cpp or c++ -O2 -shared -fPIC program.cpp -o program.so" << std::endl;
 }
 
 void setup()
@@ -4,9 +4,9 @@
 #include <iostream>
 #include <filesystem>
 #include <boost/filesystem/file_status.hpp>
-#include <boost/winapi/thread.hpp>
 
 #include "exception.h"
 #include "process.h"
+#include "aot_translator.h"
 
 #endif
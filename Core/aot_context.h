@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+// Interface between the interpreter and a module built from evm2c output.
+// aot_translator writes the same definitions into the generated source, the
+// module exports sizeof its context so a mismatch is detected at load time.
+struct evm2_aot_context
+{
+	int64_t* registers;
+	int8_t* memory;
+	uint64_t memory_size;
+	uint32_t* stack;
+	uint32_t* stack_position;
+	uint32_t instruction_pointer;            // where the interpreter continues after the module left
+	void* runtime;                           // machine executing the module
+	int (*execute)(evm2_aot_context*, uint32_t); // I/O, threads, locks, sleep - see aot_module::execute
+	int (*checkpoint)(evm2_aot_context*);    // at backward jumps, 0: stopped or out of its time slice - leave
+};
+
+// generated function, returns 0 after ret of a nested call, 1 when it leaves
+// to the interpreter at context->instruction_pointer
+using aot_function = int (*)(evm2_aot_context*, int);
+
+struct evm2_aot_entry
+{
+	uint32_t address;
+	aot_function function;
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "pch.h"
+
+// executes the host instruction at address: 0 when it wasn't executed,
+// 1 to continue, 2 when it was executed but the machine should stop
+int aot_module::execute(evm2_aot_context* context, uint32_t address)
+{
+	auto& machine = *static_cast<::machine*>(context->runtime);
+	const auto& instruction = machine.code->at(address);
+
+	machine.current = &instruction.instruction;
+	machine.instruction_pointer = address + instruction.instruction.length;
+	if (!machine.host || !machine.host->execute(machine, instruction.instruction.op_code))
+		return 0;
+	return machine.can_run() ? 1 : 2;
+}
+
+// counts towards the stop request check and the time slice like a transfer of the threaded engine
+int aot_module::checkpoint(evm2_aot_context* context)
+{
+	return static_cast<machine*>(context->runtime)->checkpoint();
+}
+
+bool aot_module::run(machine& machine, aot_function function, uint32_t& address)
+{
+	evm2_aot_context context = {
+		machine.registers.data(),
+		machine.memory.data(),
+		machine.memory.size(),
+		machine.stack.data(),
+		&machine.stack_position,
+		machine.instruction_pointer,
+		&machine,
+		execute,
+		checkpoint };
+
+	// a failed checkpoint sets exit_op_code to stopped or yielded
+	machine.exit_op_code = block_link;
+	function(&context, 0);
+	address = context.instruction_pointer;
+	return machine.exit_op_code == block_link;
+}
+
+aot_module::aot_module(const std::string& file_name, const evm2_code& code)
+{
+	try
+	{
+		library.load(file_name);
+	}
+	catch (const std::exception& ex)
+	{
+		throw image_exception(boost::format("Native module %1% load error: %2%") % file_name % ex.what());
+	}
+
+	if (!library.has("evm2_aot_image_hash") || !library.has("evm2_aot_context_size") || !library.has("evm2_aot_entries"))
+		throw image_exception(boost::format("Invalid native module %1% - not built from evm2c output") % file_name);
+
+	if (library.get<uint32_t()>("evm2_aot_context_size")() != sizeof(evm2_aot_context))
+		throw image_exception(boost::format("Invalid native module %1% - built by another version") % file_name);
+
+	if (library.get<uint64_t()>("evm2_aot_image_hash")() != code.hash())
+		throw image_exception(boost::format("Invalid native module %1% - built for another image") % file_name);
+
+	uint32_t count = 0;
+	const auto* entries = library.get<const evm2_aot_entry*(uint32_t*)>("evm2_aot_entries")(&count);
+	for (uint32_t i = 0; i < count; i++)
+		functions[entries[i].address] = entries[i].function;
+}
+
+std::shared_ptr<aot_module> aot_module::factory::create(const std::string& file_name, const evm2_code& code)
+{
+	return std::make_shared<aot_module>(file_name, code);
+}
\ No newline at end of file
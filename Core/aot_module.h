@@ -0,0 +1,40 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <boost/dll/shared_library.hpp>
+#include "aot_context.h"
+#include "evm2_types.h"
+
+class machine;
+
+// Native code of an image, built with the host compiler from evm2c output
+// (see aot_translator). The threaded engine enters a function of the module
+// whenever control reaches its entry address and continues interpreting where
+// the function left.
+class aot_module
+{
+	boost::dll::shared_library library;
+	std::unordered_map<uint32_t, aot_function> functions; // entry address -> function
+
+	static int execute(evm2_aot_context*, uint32_t);
+	static int checkpoint(evm2_aot_context*);
+
+public:
+	aot_module(const std::string&, const evm2_code&);
+
+	aot_function find(uint32_t address) const
+	{
+		const auto function = functions.find(address);
+		return function == functions.end() ? nullptr : function->second;
+	}
+
+	// runs the function on the machine state, address: the bit address to continue with,
+	// false if the machine was stopped or its time slice ended at a checkpoint of the function
+	static bool run(machine&, aot_function, uint32_t& address);
+
+	struct factory
+	{
+		static std::shared_ptr<aot_module> create(const std::string&, const evm2_code&);
+	};
+};
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "pch.h"
+
+namespace
+{
+	// definitions shared with the runtime, see aot_context.h
+	const char* const prelude = R"(// generated by evm2c
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#define EVM2_EXPORT extern "C" __declspec(dllexport)
+#else
+#define EVM2_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4102) // unreferenced label
+#else
+#pragma GCC diagnostic ignored "-Wunused-label"
+#endif
+
+struct evm2_aot_context
+{
+	int64_t* registers;
+	int8_t* memory;
+	uint64_t memory_size;
+	uint32_t* stack;
+	uint32_t* stack_position;
+	uint32_t instruction_pointer;
+	void* runtime;
+	int (*execute)(evm2_aot_context*, uint32_t);
+	int (*checkpoint)(evm2_aot_context*);
+};
+
+struct evm2_aot_entry
+{
+	uint32_t address;
+	int (*function)(evm2_aot_context*, int);
+};
+
+static inline int leave(evm2_aot_context* c, uint32_t address)
+{
+	c->instruction_pointer = address;
+	return 1;
+}
+
+template<int size> static inline bool load(evm2_aot_context* c, int64_t address, int64_t& value)
+{
+	if (static_cast<uint64_t>(address) >= c->memory_size || static_cast<uint64_t>(address) + size > c->memory_size)
+		return false;
+	uint64_t result = 0;
+	std::memcpy(&result, c->memory + address, size);
+	value = static_cast<int64_t>(result);
+	return true;
+}
+
+template<int size> static inline bool store(evm2_aot_context* c, int64_t address, int64_t value)
+{
+	if (static_cast<uint64_t>(address) >= c->memory_size || static_cast<uint64_t>(address) + size > c->memory_size)
+		return false;
+	std::memcpy(c->memory + address, &value, size);
+	return true;
+}
+
+static inline int64_t compare(int64_t a, int64_t b)
+{
+	return a == b ? 0 : a > b ? 1 : -1;
+}
+
+static inline int64_t wrap(uint64_t value)
+{
+	return static_cast<int64_t>(value);
+}
+
+)";
+
+	const char* const mnemonics[] = {
+		"mov", "loadConst", "add", "sub", "div", "mod", "mul", "compare", "jump", "jumpEqual",
+		"read", "write", "consoleRead", "consoleWrite", "createThread", "joinThread", "hlt", "sleep",
+		"call", "ret", "lock", "unlock", "unknown", "unknown", "unknown", "padding" };
+
+	std::string label(uint32_t address) { return "L_" + std::to_string(address); }
+	std::string function_name(uint32_t address) { return "f_" + std::to_string(address); }
+	std::string leave(uint32_t address) { return "return leave(c, " + std::to_string(address) + ");\n"; }
+
+	bool falls_through(evm2_op_code op_code)
+	{
+		switch (op_code)
+		{
+			case jump_address:
+			case ret:
+			case halt:
+			case padding:
+			case ukn01011:
+			case ukn01111:
+			case ukn010000:
+				return false;
+			default:
+				return true;
+		}
+	}
+
+	bool is_host(evm2_op_code op_code)
+	{
+		switch (op_code)
+		{
+			case bin_read:
+			case bin_write:
+			case con_read:
+			case con_write:
+			case thread_create:
+			case thread_join:
+			case thread_sleep:
+			case lock:
+			case unlock:
+				return true;
+			default:
+				return false;
+		}
+	}
+}
+
+void aot_translator::collect(uint32_t entry, function_body& body, std::set<uint32_t>& entries)
+{
+	std::vector<uint32_t> pending{ entry };
+	const auto size = static_cast<uint32_t>(code.size());
+
+	while (!pending.empty())
+	{
+		const auto address = pending.back();
+		pending.pop_back();
+		if (address >= size || body.count(address))
+			continue;
+
+		code_decoder.jump(address);
+		const auto op_code = code_decoder.fetch();
+		const auto& instruction = body[address] = code_decoder.instruction;
+
+		if (falls_through(op_code))
+			pending.push_back(code_decoder.get_address());
+		if (op_code == jump_address || op_code == jump_equal)
+			pending.push_back(instruction.address);
+		if ((op_code == call || op_code == thread_create) && instruction.address < size)
+			entries.insert(instruction.address);
+	}
+}
+
+void aot_translator::discover()
+{
+	std::set<uint32_t> entries{ evm_default_entry_point };
+	std::set<uint32_t> done;
+
+	while (entries.size() != done.size())
+		for (const auto entry : std::set<uint32_t>(entries))
+			if (done.insert(entry).second)
+				collect(entry, functions[entry], entries);
+}
+
+std::string aot_translator::read_argument(instruction_argument argument, const char* variable, uint32_t address)
+{
+	const auto source = "r[" + std::to_string(argument.register_number()) + "]";
+	if (!argument.is_memory_access())
+		return "\t" + std::string(variable) + " = " + source + ";\n";
+
+	return "\tif (!load<" + std::to_string(1 << argument.memory_access_size()) + ">(c, " + source + ", " +
+		variable + "))\n\t\t" + leave(address);
+}
+
+std::string aot_translator::write_argument(instruction_argument argument, const std::string& value, uint32_t address)
+{
+	const auto target = "r[" + std::to_string(argument.register_number()) + "]";
+	if (!argument.is_memory_access())
+		return "\t" + target + " = " + value + ";\n";
+
+	return "\tif (!store<" + std::to_string(1 << argument.memory_access_size()) + ">(c, " + target + ", " +
+		value + "))\n\t\t" + leave(address);
+}
+
+void aot_translator::emit_instruction(std::ostream& out, uint32_t address, const evm2_instruction& instruction) const
+{
+	const auto* arguments = instruction.arguments;
+	const auto next = address + instruction.length;
+	const auto size = static_cast<uint32_t>(code.size());
+
+	// jump to the instruction address, a backward one checks the stop request and the time slice
+	const auto jump = [&](const std::string& indent)
+	{
+		if (instruction.address >= size)
+			return indent + leave(address); // let the interpreter throw
+		auto result = std::string();
+		if (instruction.address <= address)
+			result = indent + "if (!c->checkpoint(c))\n" + indent + "\t" + leave(instruction.address);
+		return result + indent + "goto " + label(instruction.address) + ";\n";
+	};
+
+	switch (const auto op_code = instruction.op_code)
+	{
+		case load_const:
+			out << write_argument(arguments[0], (boost::format("wrap(0x%016xull)") % static_cast<uint64_t>(instruction.constant)).str(), address);
+			break;
+
+		case mov:
+			out << read_argument(arguments[0], "a", address)
+				<< write_argument(arguments[1], "a", address);
+			break;
+
+		case add:
+		case sub:
+		case mul:
+		case divide:
+		case mod:
+		case compare:
+			out << read_argument(arguments[0], "a", address)
+				<< read_argument(arguments[1], "b", address);
+			if (op_code == divide || op_code == mod)
+				out << "\tif (b == 0 || (a == INT64_MIN && b == -1))\n\t\t" << leave(address);
+			out << write_argument(arguments[2],
+				op_code == add ? "wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b))" :
+				op_code == sub ? "wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b))" :
+				op_code == mul ? "wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b))" :
+				op_code == divide ? "a / b" :
+				op_code == mod ? "a % b" : "compare(a, b)", address);
+			break;
+
+		case jump_address:
+			out << jump("\t");
+			break;
+
+		case jump_equal:
+			out << read_argument(arguments[0], "a", address)
+				<< read_argument(arguments[1], "b", address)
+				<< "\tif (a == b)\n\t{\n" << jump("\t\t") << "\t}\n";
+			break;
+
+		case call:
+			if (instruction.address >= size)
+			{
+				out << "\t" << leave(address);
+				break;
+			}
+			out << "\tif (*c->stack_position == 1)\n\t\t" << leave(address)
+				<< "\tc->stack[--*c->stack_position] = " << next << ";\n"
+				<< "\tif (" << function_name(instruction.address) << "(c, depth + 1))\n\t\treturn 1;\n";
+			break;
+
+		case ret:
+			// the outermost function doesn't know where to return to
+			out << "\tif (depth == 0 || c->stack[*c->stack_position] >= " << size << ")\n\t\t" << leave(address)
+				<< "\t++*c->stack_position;\n\treturn 0;\n";
+			break;
+
+		default:
+			if (!is_host(op_code))
+			{
+				out << "\t" << leave(address); // halt, padding, unknown instructions
+				break;
+			}
+			out << "\tswitch (c->execute(c, " << address << "))\n\t{\n"
+				<< "\t\tcase 0: " << leave(address)
+				<< "\t\tcase 2: " << leave(next)
+				<< "\t}\n";
+			break;
+	}
+}
+
+void aot_translator::emit_function(std::ostream& out, uint32_t entry, const function_body& body) const
+{
+	const auto size = static_cast<uint32_t>(code.size());
+
+	out << "static int " << function_name(entry) << "(evm2_aot_context* c, int depth)\n{\n"
+		<< "\tint64_t* const r = c->registers;\n"
+		<< "\tint64_t a, b;\n"
+		<< "\t(void)r; (void)a; (void)b; (void)depth;\n";
+	if (body.empty())
+		out << "\t" << leave(entry);
+	else if (body.begin()->first != entry)
+		out << "\tgoto " << label(entry) << ";\n";
+
+	for (auto i = body.begin(); i != body.end(); ++i)
+	{
+		const auto address = i->first;
+		const auto& instruction = i->second;
+		out << label(address) << ": // " << mnemonics[instruction.op_code] << "\n";
+		emit_instruction(out, address, instruction);
+
+		if (!falls_through(instruction.op_code))
+			continue;
+		const auto next = address + instruction.length;
+		if (next >= size)
+			out << "\t" << leave(next);
+		else if (std::next(i) == body.end() || std::next(i)->first != next)
+			out << "\tgoto " << label(next) << ";\n";
+	}
+	out << "}\n\n";
+}
+
+void aot_translator::translate(std::ostream& out)
+{
+	if (functions.empty())
+		discover();
+
+	out << prelude;
+	out << "static_assert(sizeof(evm2_aot_context) == " << sizeof(evm2_aot_context) << ", \"context layout\");\n\n";
+
+	for (const auto& function : functions)
+		out << "static int " << function_name(function.first) << "(evm2_aot_context*, int);\n";
+	out << "\n";
+
+	for (const auto& function : functions)
+		emit_function(out, function.first, function.second);
+
+	out << "static const evm2_aot_entry entries[] =\n{\n";
+	for (const auto& function : functions)
+		out << "\t{ " << function.first << ", " << function_name(function.first) << " },\n";
+	out << "};\n\n";
+
+	out << "EVM2_EXPORT uint64_t evm2_aot_image_hash() { return " << code.hash() << "ull; }\n"
+		<< "EVM2_EXPORT uint32_t evm2_aot_context_size() { return sizeof(evm2_aot_context); }\n"
+		<< "EVM2_EXPORT const evm2_aot_entry* evm2_aot_entries(uint32_t* count)\n{\n"
+		<< "\t*count = sizeof entries / sizeof entries[0];\n\treturn entries;\n}\n";
+}
+
+aot_translator::aot_translator(evm2_code& code) : code(code), code_decoder(code, evm_default_entry_point) {}
+
+std::shared_ptr<aot_translator> aot_translator::factory::create(evm2_code& code)
+{
+	return std::make_shared<aot_translator>(code);
+}
\ No newline at end of file
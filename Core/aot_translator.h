@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include "decoder.h"
+#include "evm2_types.h"
+
+// Ahead-of-time translation of an image to C++ source (evm2c).
+// Every call target, thread entry point and the program entry point becomes one
+// function, the code reachable from it by jumps and fall-through becomes its
+// body with a label per instruction. Guest registers, memory and stack stay in
+// the machine. Anything the generated code can't do the way the interpreter
+// does - faults, host instructions refused, ret of the outermost call, halt -
+// leaves to the interpreter at the instruction, before any of its effects.
+class aot_translator
+{
+	using function_body = std::map<uint32_t, evm2_instruction>; // bit address -> instruction
+
+	evm2_code& code;
+	decoder code_decoder;
+	std::map<uint32_t, function_body> functions; // entry address -> body
+
+	void discover();
+	void collect(uint32_t, function_body&, std::set<uint32_t>&);
+
+	void emit_function(std::ostream&, uint32_t, const function_body&) const;
+	void emit_instruction(std::ostream&, uint32_t, const evm2_instruction&) const;
+	static std::string read_argument(instruction_argument, const char*, uint32_t);
+	static std::string write_argument(instruction_argument, const std::string&, uint32_t);
+
+public:
+	explicit aot_translator(evm2_code&);
+
+	void translate(std::ostream&);
+
+	struct factory
+	{
+		static std::shared_ptr<aot_translator> create(evm2_code&);
+	};
+};
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "pch.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr uint64_t min_capacity = 0x100000;
+#ifdef _WIN32
+	constexpr size_t max_transfer = 1u << 30; // ReadFile/WriteFile take a DWORD count
+
+	// event of the calling thread for its overlapped transfers
+	HANDLE io_event()
+	{
+		thread_local const std::unique_ptr<void, decltype(&CloseHandle)> event(
+			CreateEventW(nullptr, TRUE, FALSE, nullptr), &CloseHandle);
+		return event.get();
+	}
+
+	OVERLAPPED overlapped_at(uint64_t position)
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(position);
+		overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+		overlapped.hEvent = io_event();
+		return overlapped;
+	}
+#endif
+}
+
+// holds a byte range of the file, waits while it overlaps one held by another transfer
+class binary_file::range_lock
+{
+	binary_file& file;
+	const std::pair<uint64_t, uint64_t> range;
+
+public:
+	range_lock(binary_file& file, uint64_t begin, uint64_t end) : file(file), range(begin, end)
+	{
+		std::unique_lock lock(file.ranges_mutex);
+		file.range_released.wait(lock, [this]
+		{
+			return std::none_of(this->file.ranges.begin(), this->file.ranges.end(), [this](const auto& held)
+			{
+				return held.first < range.second && range.first < held.second;
+			});
+		});
+		file.ranges.push_back(range);
+	}
+
+	~range_lock()
+	{
+		{
+			std::lock_guard lock_guard(file.ranges_mutex);
+			file.ranges.erase(std::find(file.ranges.begin(), file.ranges.end(), range));
+		}
+		file.range_released.notify_all();
+	}
+};
+
+size_t binary_file::read(uint64_t offset, uint8_t* destination, size_t count)
+{
+	const auto current_size = size();
+	if (!count || offset >= current_size)
+		return 0;
+
+	count = static_cast<size_t>((std::min)(static_cast<uint64_t>(count), current_size - offset));
+	range_lock lock(*this, offset, offset + count);
+	if (!mapped)
+	{
+		// writes of the range wait for the range lock, nothing of it gets pending meanwhile
+		write_pending(offset, offset + count);
+		return read_at(offset, destination, count);
+	}
+
+	std::shared_lock region_lock(region_mutex);
+	std::memcpy(destination, static_cast<const uint8_t*>(region.get_address()) + offset, count);
+	return count;
+}
+
+void binary_file::write(uint64_t offset, const uint8_t* source, size_t count)
+{
+	// the end of the range must neither wrap nor be negative as an off_t
+	if (count > UINT64_MAX - offset || offset + count > INT64_MAX)
+		throw exception(std::string("Binary file offset out of range"));
+
+	// a write past the end holds the gap it pads as well, the size only grows
+	range_lock lock(*this, (std::min)(offset, size()), offset + count);
+	if (mapped)
+	{
+		// the mapping past size() is zeroes, nothing is written there before size() covers it
+		if (offset + count > capacity)
+			reserve(offset + count);
+		std::shared_lock region_lock(region_mutex);
+		if (count)
+			std::memcpy(static_cast<uint8_t*>(region.get_address()) + offset, source, count);
+	}
+	else
+	{
+		if (offset > size())
+			grow_to(offset);
+		if (!buffer(offset, source, count))
+			write_at(offset, source, count);
+	}
+
+	auto current_size = size();
+	while (current_size < offset + count && !file_size.compare_exchange_weak(current_size, offset + count)) {}
+}
+
+// coalesces a write with the pending run, false if it's to be written directly
+bool binary_file::buffer(uint64_t offset, const uint8_t* source, size_t count)
+{
+	if (!count)
+		return true;
+
+	auto schedule = false;
+	{
+		std::lock_guard lock_guard(pending_mutex);
+		// a direct write goes after the pending run, which may overlap it
+		const auto continues = !pending.empty() && offset >= pending_offset && offset <= pending_offset + pending.size();
+		if (!continues || count >= max_pending || offset + count - pending_offset > max_pending)
+			write_pending();
+		if (count >= max_pending)
+			return false;
+
+		if (pending.empty())
+		{
+			pending_offset = offset;
+			schedule = !std::exchange(flush_scheduled, true);
+		}
+		const auto position = static_cast<size_t>(offset - pending_offset);
+		if (pending.size() < position + count)
+			pending.resize(position + count);
+		std::memcpy(pending.data() + position, source, count);
+	}
+
+	// timer callbacks run under the queue lock and take pending_mutex
+	if (schedule && timers)
+		timers->add(timer_queue::deadline_after(flush_delay), [file = weak_from_this()]
+		{
+			if (const auto locked = file.lock())
+				locked->flush();
+		});
+	return true;
+}
+
+// under pending_mutex
+void binary_file::write_pending()
+{
+	if (!pending.empty())
+		write_at(pending_offset, pending.data(), pending.size());
+	pending.clear();
+}
+
+// writes the pending run if it overlaps [begin, end)
+void binary_file::write_pending(uint64_t begin, uint64_t end)
+{
+	std::lock_guard lock_guard(pending_mutex);
+	if (!pending.empty() && pending_offset < end && begin < pending_offset + pending.size())
+		write_pending();
+}
+
+// the file system pads with zeroes, the gap stays a hole where it supports sparse files
+void binary_file::grow_to(uint64_t new_size)
+{
+	if (!resize(new_size))
+		throw exception(std::string("Binary file can't grow"));
+
+	auto current_size = size();
+	while (current_size < new_size && !file_size.compare_exchange_weak(current_size, new_size)) {}
+}
+
+void binary_file::flush()
+{
+	{
+		std::lock_guard lock_guard(pending_mutex);
+		write_pending();
+		flush_scheduled = false;
+	}
+
+	std::shared_lock region_lock(region_mutex);
+	if (mapped && region.get_size())
+		region.flush(0, 0, false);
+}
+
+void binary_file::map(const std::string& file_name)
+{
+	try
+	{
+		mapping = boost::interprocess::file_mapping(file_name.c_str(), boost::interprocess::read_write);
+		capacity = size();
+		if (capacity)
+			region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_write, 0, capacity);
+		mapped = true;
+	}
+	catch (const boost::interprocess::interprocess_exception&)
+	{
+		region = boost::interprocess::mapped_region();
+		mapping = boost::interprocess::file_mapping();
+		capacity = 0;
+	}
+}
+
+// grows the file and its mapping to at least end, doubling to keep appends from remapping each time
+void binary_file::reserve(uint64_t end)
+{
+	std::unique_lock region_lock(region_mutex);
+	if (end <= capacity)
+		return;
+
+	const auto new_capacity = (std::max)({ end, capacity * 2, min_capacity });
+	region = boost::interprocess::mapped_region();
+	const auto grown = resize(new_capacity);
+	if (grown)
+		capacity = new_capacity;
+	if (capacity)
+		region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_write, 0, capacity);
+	if (!grown)
+		throw exception(std::string("Binary file can't grow"));
+}
+
+binary_file::~binary_file()
+{
+	write_pending();
+	if (mapped)
+	{
+		region = boost::interprocess::mapped_region();
+		resize(size()); // cut off the unused part of the mapping
+	}
+#ifdef _WIN32
+	CloseHandle(handle);
+#else
+	close(descriptor);
+#endif
+}
+
+std::shared_ptr<binary_file> binary_file::factory::create(const std::string& file_name, bool mapped)
+{
+	auto file = create(file_name);
+	if (file && mapped)
+		file->map(file_name);
+	return file;
+}
+
+#ifdef _WIN32
+
+binary_file::binary_file(void* handle) : handle(handle)
+{
+	LARGE_INTEGER initial_size = {};
+	GetFileSizeEx(handle, &initial_size);
+	file_size = static_cast<uint64_t>(initial_size.QuadPart);
+}
+
+bool binary_file::resize(uint64_t new_size)
+{
+	if (new_size > size())
+	{
+		// NTFS allocates and zeroes an extension unless the file is sparse
+		auto overlapped = overlapped_at(0);
+		DWORD returned = 0;
+		if (DeviceIoControl(handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, nullptr, &overlapped) || GetLastError() == ERROR_IO_PENDING)
+			GetOverlappedResult(handle, &overlapped, &returned, TRUE);
+	}
+
+	FILE_END_OF_FILE_INFO end_of_file = {};
+	end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(new_size);
+	return SetFileInformationByHandle(handle, FileEndOfFileInfo, &end_of_file, sizeof end_of_file) != FALSE;
+}
+
+size_t binary_file::read_at(uint64_t offset, uint8_t* destination, size_t count)
+{
+	size_t done = 0;
+	while (done < count)
+	{
+		auto overlapped = overlapped_at(offset + done);
+		DWORD transferred = 0;
+		const auto chunk = static_cast<DWORD>((std::min)(count - done, max_transfer));
+		if (!ReadFile(handle, destination + done, chunk, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+			break;
+		if (!GetOverlappedResult(handle, &overlapped, &transferred, TRUE) || !transferred)
+			break;
+		done += transferred;
+	}
+	return done;
+}
+
+void binary_file::write_at(uint64_t offset, const uint8_t* source, size_t count)
+{
+	size_t done = 0;
+	while (done < count)
+	{
+		auto overlapped = overlapped_at(offset + done);
+		DWORD transferred = 0;
+		const auto chunk = static_cast<DWORD>((std::min)(count - done, max_transfer));
+		if (!WriteFile(handle, source + done, chunk, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+			break;
+		if (!GetOverlappedResult(handle, &overlapped, &transferred, TRUE) || !transferred)
+			break;
+		done += transferred;
+	}
+}
+
+std::shared_ptr<binary_file> binary_file::factory::create(const std::string& file_name)
+{
+	const auto handle = CreateFileA(file_name.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return nullptr;
+	return std::make_shared<binary_file>(handle);
+}
+
+#else
+
+binary_file::binary_file(int descriptor) : descriptor(descriptor)
+{
+	struct stat status = {};
+	if (fstat(descriptor, &status) == 0)
+		file_size = static_cast<uint64_t>(status.st_size);
+}
+
+bool binary_file::resize(uint64_t new_size)
+{
+	return ftruncate(descriptor, static_cast<off_t>(new_size)) == 0;
+}
+
+size_t binary_file::read_at(uint64_t offset, uint8_t* destination, size_t count)
+{
+	size_t done = 0;
+	while (done < count)
+	{
+		const auto transferred = pread(descriptor, destination + done, count - done, static_cast<off_t>(offset + done));
+		if (transferred < 0 && errno == EINTR)
+			continue;
+		if (transferred <= 0)
+			break;
+		done += static_cast<size_t>(transferred);
+	}
+	return done;
+}
+
+void binary_file::write_at(uint64_t offset, const uint8_t* source, size_t count)
+{
+	size_t done = 0;
+	while (done < count)
+	{
+		const auto transferred = pwrite(descriptor, source + done, count - done, static_cast<off_t>(offset + done));
+		if (transferred < 0 && errno == EINTR)
+			continue;
+		if (transferred <= 0)
+			break;
+		done += static_cast<size_t>(transferred);
+	}
+}
+
+std::shared_ptr<binary_file> binary_file::factory::create(const std::string& file_name)
+{
+	const auto descriptor = open(file_name.c_str(), O_RDWR | O_CREAT, 0666);
+	if (descriptor < 0)
+		return nullptr;
+	return std::make_shared<binary_file>(descriptor);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "timer_queue.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+// The [file.bin] of a process.
+// Positional transfers - pread/pwrite, overlapped ReadFile/WriteFile on
+// Windows - there is no shared file position, so transfers of different
+// threads only wait for each other when their byte ranges overlap.
+// The file size is cached, the file is only changed through this object.
+// A mapped file is read and written by copies from and to its mapping, the
+// mapping grows by doubling and the file is cut back to its size on close.
+// Otherwise small writes which continue each other are coalesced in a pending
+// run, written when it's full, flush_delay after it started, by flush or by a
+// read of its range.
+class binary_file : public std::enable_shared_from_this<binary_file>
+{
+#ifdef _WIN32
+	void* handle;
+#else
+	int descriptor;
+#endif
+	std::atomic<uint64_t> file_size{ 0 };
+
+	// byte ranges being transferred
+	std::mutex ranges_mutex;
+	std::condition_variable range_released;
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+	class range_lock;
+
+	size_t read_at(uint64_t, uint8_t*, size_t);
+	void write_at(uint64_t, const uint8_t*, size_t);
+	void grow_to(uint64_t);
+	bool resize(uint64_t);
+
+	// write-behind
+	static constexpr size_t max_pending = 0x100000;
+	static constexpr int64_t flush_delay = 50; // milliseconds
+	std::mutex pending_mutex;
+	uint64_t pending_offset = 0;
+	std::vector<uint8_t> pending;
+	bool flush_scheduled = false;
+	bool buffer(uint64_t, const uint8_t*, size_t);
+	void write_pending();
+	void write_pending(uint64_t, uint64_t);
+
+	// mapped mode
+	bool mapped = false;
+	boost::interprocess::file_mapping mapping;
+	boost::interprocess::mapped_region region;
+	std::shared_mutex region_mutex; // copies share it, remapping takes it exclusively
+	std::atomic<uint64_t> capacity{ 0 }; // size of the mapping, at least size()
+	void map(const std::string&);
+	void reserve(uint64_t);
+
+public:
+#ifdef _WIN32
+	explicit binary_file(void*);
+#else
+	explicit binary_file(int);
+#endif
+	~binary_file();
+	binary_file(const binary_file&) = delete;
+	binary_file& operator=(const binary_file&) = delete;
+
+	uint64_t size() const { return file_size; }
+
+	// up to count bytes at offset, returns the number of bytes read
+	size_t read(uint64_t offset, uint8_t* destination, size_t count);
+	// a write past the end pads the file with zeroes up to offset, as a hole if the file system can
+	void write(uint64_t offset, const uint8_t* source, size_t count);
+	// writes the pending run, mapped mode: writes the mapping back to the file
+	void flush();
+
+	std::shared_ptr<timer_queue> timers; // flushes a pending run after flush_delay, none: on the next write or flush
+
+	struct factory
+	{
+		// opens or creates the file, nullptr if that fails
+		static std::shared_ptr<binary_file> create(const std::string&);
+		// mapped: copy from and to a mapping of the file, positional transfers if it can't be mapped
+		static std::shared_ptr<binary_file> create(const std::string&, bool mapped);
+	};
+};
\ No newline at end of file
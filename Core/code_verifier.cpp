@@ -0,0 +1,90 @@
+#include "pch.h"
+
+void code_verifier::walk(evm2_code& code)
+{
+	const auto size = static_cast<uint32_t>(code.size());
+	decoder code_decoder(code, evm_default_entry_point);
+	std::vector<uint32_t> pending{ evm_default_entry_point };
+	std::vector<bool> block_starts(code.size(), false);
+
+	if (evm_default_entry_point < size)
+		block_starts[evm_default_entry_point] = true;
+
+	while (!pending.empty())
+	{
+		const auto address = pending.back();
+		pending.pop_back();
+		if (address >= size || reachable[address])
+			continue;
+
+		reachable[address] = true;
+
+		code_decoder.jump(address);
+		const auto op_code = code_decoder.fetch();
+		const auto target = code_decoder.instruction.address;
+		const auto next = code_decoder.get_address();
+		instructions.push_back({ code_decoder.instruction, address, 0 });
+
+		switch (op_code)
+		{
+			case jump_address:
+			case jump_equal:
+			case call:
+			case thread_create:
+				if (target >= size)
+				{
+					valid_targets = false;
+					break;
+				}
+				target_checked[address] = true;
+				block_starts[target] = true;
+				pending.push_back(target);
+				break;
+
+			case ukn01011:
+			case ukn01111:
+			case ukn010000:
+				known_op_codes = false;
+				continue;
+
+			default:
+				break;
+		}
+
+		if ((op_code == jump_equal || op_code == call) && next < size)
+			block_starts[next] = true;
+
+		// execution continues after everything but these (call returns after it)
+		if (op_code != jump_address && op_code != ret && op_code != halt && op_code != padding)
+			pending.push_back(next);
+	}
+
+	std::sort(instructions.begin(), instructions.end(),
+		[](const auto& a, const auto& b) { return a.address < b.address; });
+	for (auto& instruction : instructions)
+		instruction.flags =
+			(block_starts[instruction.address] ? uint32_t(verified_instruction::block_start) : 0u) |
+			(target_checked[instruction.address] ? uint32_t(verified_instruction::target_checked) : 0u);
+}
+
+code_verifier::code_verifier(evm2_code& code)
+	: reachable(code.size(), false), target_checked(code.size(), false)
+{
+	walk(code);
+}
+
+code_verifier::code_verifier(size_t code_size, std::vector<verified_instruction> instructions, bool valid_targets, bool known_op_codes)
+	: instructions(std::move(instructions)), reachable(code_size, false), target_checked(code_size, false),
+	valid_targets(valid_targets), known_op_codes(known_op_codes)
+{
+	for (const auto& instruction : this->instructions)
+	{
+		reachable[instruction.address] = true;
+		target_checked[instruction.address] = (instruction.flags & verified_instruction::target_checked) != 0;
+	}
+}
+
+std::shared_ptr<code_verifier> code_verifier::factory::create(evm2_code& code)
+{
+	return std::make_shared<code_verifier>(code);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "decoder.h"
+#include "evm2_types.h"
+
+// reachable instruction as recorded by the verifier (and stored in .evmc files)
+struct verified_instruction
+{
+	enum : uint32_t
+	{
+		block_start = 1,    // entry point, jump/call/thread target or follows a jumpEqual/call
+		target_checked = 2  // its jump/call target is inside the code
+	};
+
+	evm2_instruction instruction;
+	uint32_t address;
+	uint32_t flags;
+};
+
+// Load time verification of the code reachable from the entry point, call
+// targets and thread entry points. The facts are proven once per image, the
+// program uses them to pick handlers without run time checks.
+class code_verifier
+{
+	std::vector<verified_instruction> instructions; // reachable instructions ordered by address
+	std::vector<bool> reachable;      // bit address -> a reachable instruction starts here
+	std::vector<bool> target_checked; // bit address -> its jump/call target is inside the code
+	bool valid_targets = true;        // no reachable jump, call or thread entry outside the code
+	bool known_op_codes = true;       // no reachable 01011, 01111 or 010000 encoding
+
+	void walk(evm2_code&);
+
+public:
+	explicit code_verifier(evm2_code&);
+
+	// facts restored from an image cache
+	code_verifier(size_t, std::vector<verified_instruction>, bool, bool);
+
+	bool verified() const { return valid_targets && known_op_codes; }
+	bool targets_valid() const { return valid_targets; }
+	bool op_codes_known() const { return known_op_codes; }
+
+	size_t reachable_instructions() const { return instructions.size(); }
+	const std::vector<verified_instruction>& reachable_code() const { return instructions; }
+
+	bool is_reachable(uint32_t address) const { return address < reachable.size() && reachable[address]; }
+
+	// jump, jumpEqual or call at address can't leave the code
+	bool target_verified(uint32_t address) const { return address < target_checked.size() && target_checked[address]; }
+
+	struct factory
+	{
+		static std::shared_ptr<code_verifier> create(evm2_code&);
+	};
+};
\ No newline at end of file
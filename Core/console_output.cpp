@@ -0,0 +1,55 @@
+#include "pch.h"
+
+console_output::console_output(std::ostream& stream) : stream(stream)
+{
+	buffer.reserve(capacity);
+}
+
+console_output::~console_output()
+{
+	try
+	{
+		flush();
+	}
+	catch (...) {}
+}
+
+void console_output::write(uint64_t number)
+{
+	static constexpr char digits[] = "0123456789abcdef";
+
+	char line[line_size];
+	for (auto i = line_size - 1; i-- > 0; number >>= 4)
+		line[i] = digits[number & 0xf];
+	line[line_size - 1] = '\n';
+
+	std::lock_guard lock_guard(mutex);
+	if (buffer.size() + line_size > capacity)
+		write_buffer();
+	buffer.insert(buffer.end(), line, line + line_size);
+	if (interactive)
+		write_buffer();
+}
+
+void console_output::message(const std::string& text)
+{
+	std::lock_guard lock_guard(mutex);
+	buffer.insert(buffer.end(), text.begin(), text.end());
+	buffer.push_back('\n');
+	write_buffer();
+}
+
+void console_output::flush()
+{
+	std::lock_guard lock_guard(mutex);
+	write_buffer();
+}
+
+// under mutex
+void console_output::write_buffer()
+{
+	if (!buffer.empty())
+		stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	stream.flush();
+	buffer.clear();
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Console output of a process. A value becomes its 16 digit hex line without
+// iostream formatting and is collected in one buffer, which goes to the stream
+// in one write when it's full, on flush, or after every value when interactive.
+// Messages, such as faults of threads, follow the values written before them.
+class console_output
+{
+	static constexpr size_t line_size = 17;
+	static constexpr size_t capacity = 0x10000;
+
+	std::mutex mutex;
+	std::vector<char> buffer;
+	std::ostream& stream;
+	void write_buffer();
+
+public:
+	bool interactive = false;
+
+	explicit console_output(std::ostream&);
+	~console_output();
+	console_output(const console_output&) = delete;
+	console_output& operator=(const console_output&) = delete;
+
+	void write(uint64_t);
+	void message(const std::string&); // a line written at once, after the buffered values
+	void flush();
+};
\ No newline at end of file
@@ -1,183 +1,119 @@
 #include "pch.h"
 
+namespace
+{
+	struct op_code_entry
+	{
+		evm2_op_code op_code;
+		uint8_t length;     // op code length in bits
+		bool address;       // followed by 32-bit address
+		bool constant;      // followed by 64-bit constant
+		uint8_t arguments;  // followed by arguments
+	};
+
+	struct op_code_pattern
+	{
+		const char* bits;   // op code bits in stream order
+		op_code_entry entry;
+	};
+
+	constexpr op_code_pattern op_code_patterns[] =
+	{
+		{ "000",    { mov,           3, false, false, 2 } },
+		{ "001",    { load_const,    3, false, true,  1 } },
+		{ "010000", { ukn010000,     6, false, false, 0 } },
+		{ "010001", { add,           6, false, false, 3 } },
+		{ "010010", { sub,           6, false, false, 3 } },
+		{ "010011", { divide,        6, false, false, 3 } },
+		{ "010100", { mod,           6, false, false, 3 } },
+		{ "010101", { mul,           6, false, false, 3 } },
+		{ "01011",  { ukn01011,      5, false, false, 0 } },
+		{ "01100",  { compare,       5, false, false, 3 } },
+		{ "01101",  { jump_address,  5, true,  false, 0 } },
+		{ "01110",  { jump_equal,    5, true,  false, 2 } },
+		{ "01111",  { ukn01111,      5, false, false, 0 } },
+		{ "10000",  { bin_read,      5, false, false, 4 } },
+		{ "10001",  { bin_write,     5, false, false, 3 } },
+		{ "10010",  { con_read,      5, false, false, 1 } },
+		{ "10011",  { con_write,     5, false, false, 1 } },
+		{ "10100",  { thread_create, 5, true,  false, 1 } },
+		{ "10101",  { thread_join,   5, false, false, 1 } },
+		{ "10110",  { halt,          5, false, false, 0 } },
+		{ "10111",  { thread_sleep,  5, false, false, 1 } },
+		{ "1100",   { call,          4, true,  false, 0 } },
+		{ "1101",   { ret,           4, false, false, 0 } },
+		{ "1110",   { lock,          4, false, false, 1 } },
+		{ "1111",   { unlock,        4, false, false, 1 } },
+	};
+
+	constexpr auto op_code_window = 6; // longest op code
+
+	constexpr bool matches(const char* bits, uint32_t window)
+	{
+		for (auto i = 0; bits[i]; i++)
+			if ((bits[i] == '1') != static_cast<bool>(window >> i & 1))
+				return false;
+		return true;
+	}
+
+	// op code lookup by the next 6 bits of the stream (first stream bit is bit 0)
+	struct op_code_table
+	{
+		op_code_entry entries[1 << op_code_window] = {};
+
+		constexpr op_code_table()
+		{
+			for (uint32_t window = 0; window < 1 << op_code_window; window++)
+				for (const auto& pattern : op_code_patterns)
+					if (matches(pattern.bits, window))
+						entries[window] = pattern.entry;
+		}
+	};
+
+	constexpr op_code_table op_codes;
+}
+
 evm2_op_code decoder::fetch()
 {
 	instruction = {};
 	if (c >= padding_position && size_in_bits-c < 8)
 		return padding;
-	
-	if (code[c++])
-	{ // 1
-		if (code[c++])
-		{ // 11
-			if (code[c++])
-			{ // 111
-				if (code[c++])
-				{ // 1111
-					fetch_arguments(1);
-					return unlock;
-				}
-				// 1110
-				fetch_arguments(1);
-				return lock;
-			}
-			// 110
-			if (code[c++])
-				return ret; // 1101
-			// 1100
-			fetch_address();
-			return call;
-		}
-		// 10
-		if (code[c++])
-		{ // 101
-			if (code[c++])
-			{ // 1011
-				if (code[c++])
-				{ // 10111
-					fetch_arguments(1);
-					return sleep;
-				}
-				// 10110
-				return halt;
-			}
-			// 1010
-			if (code[c++])
-			{ // 10101
-				fetch_arguments(1);
-				return thread_join;
-			}
-			// 10100
-			fetch_address();
-			fetch_arguments(1);
-			return thread_create;
-		}
-		// 100
-		if (code[c++])
-		{ // 1001
-			if (code[c++])
-			{ // 10011
-				fetch_arguments(1);
-				return con_write;
-			}
-			// 10010
-			fetch_arguments(1);
-			return con_read;
-		}
-		// 1000
-		if (code[c++])
-		{ // 10001
-			fetch_arguments(3);
-			return write;
-		}
-		// 10000
-		fetch_arguments(4);
-		return read;
-	}
-	// 0
-	if (code[c++])
-	{ // 01
-		if (code[c++])
-		{ // 011
-			if (code[c++])
-			{ // 0111
-				if (code[c++])
-					return ukn01111; // unknown instruction 01111
-				// 01110
-				fetch_address();
-				fetch_arguments(2);
-				return jump_equal;
-			}
-			// 0110
-			if (code[c++])
-			{ // 01101
-				fetch_address();
-				return jump_address;
-			}
-			// 01100
-			fetch_arguments(3);
-			return compare;
-		}
-		// 010
-		if (code[c++])
-		{ // 0101
-			if (code[c++])
-				return ukn01011; // unknown instruction 01011
-			// 01010
-			if (code[c++])
-			{ // 010101
-				fetch_arguments(3);
-				return mul;
-			}
-			// 010100
-			fetch_arguments(3);
-			return mod;
-		}
-		// 0100
-		if (code[c++])
-		{ // 01001
-			if (code[c++])
-			{ // 010011
-				fetch_arguments(3);
-				return divide;
-			}
-			// 010010
-			fetch_arguments(3);
-			return sub;
-		}
-		// 01000
-		if (code[c++])
-		{ // 010001
-			fetch_arguments(3);
-			return add;
-		}
-		// 010000
-		return ukn010000; // unknown instruction 010000
-	}
-	// 00
-	if (code[c++])
-	{ // 001
+
+	const auto start = c;
+	const auto& entry = op_codes.entries[code.bits(c, op_code_window)];
+	c += entry.length;
+
+	if (entry.constant)
 		instruction.constant = static_cast<int64_t>(fetch_bits(64));
-		fetch_arguments(1);
-		return load_const;
-	}
-	// 000
-	fetch_arguments(2);
-	return mov;
+	if (entry.address)
+		fetch_address();
+	fetch_arguments(entry.arguments);
+
+	instruction.op_code = entry.op_code;
+	instruction.length = static_cast<uint8_t>(c - start);
+	return entry.op_code;
 }
 
 uint64_t decoder::fetch_bits(int bits_count)
 {
-	uint64_t result = 0;
-
-	for (auto i = 0; i < bits_count; i++)
-	{
-		result = result >> 1;
-		result += code[c + i] ? 0x8000000000000000 : 0;
-	}
+	const auto result = code.bits(c, bits_count);
 	c += bits_count;
-
-	if (bits_count < 64)
-		result = result >> (64 - bits_count);
-
 	return result;
 }
 
 void decoder::fetch_arguments(uint64_t count)
 {
-	for (auto i = 0; i < count; i++)
+	for (uint64_t i = 0; i < count; i++)
 	{
-		const bool memory_access = code[c++];
-		const uint8_t memory_access_size = memory_access ? static_cast<uint8_t>(fetch_bits(2)) : 0;
-		const auto register_number = static_cast<uint8_t>(fetch_bits(4));
+		// m [ss] rrrr - memory flag, access size (memory only), register
+		const auto bits = code.bits(c, 7);
+		const bool memory_access = bits & 1;
+		const uint8_t memory_access_size = memory_access ? static_cast<uint8_t>(bits >> 1 & 3) : 0;
+		const auto register_number = static_cast<uint8_t>((memory_access ? bits >> 3 : bits >> 1) & 0xf);
+		c += memory_access ? 7 : 5;
 		
-		instruction.arguments.push_back(
-			instruction_argument
-			{
-				memory_access,
-				memory_access_size,
-				register_number
-			});
+		instruction.arguments[instruction.arguments_count++] =
+			instruction_argument(memory_access, memory_access_size, register_number);
 	}
 }
 
@@ -202,9 +138,7 @@ uint32_t decoder::get_address() const
 decoder::decoder(evm2_code& code, uint32_t entry_point) : c(entry_point), code(code)
 {
 	size_in_bits = static_cast<uint32_t>(code.size());
-	padding_position = size_in_bits - 1;
-	while (!code[padding_position] && padding_position > 0)
-		padding_position--;
+	padding_position = static_cast<uint32_t>(code.find_last());
 }
 
 std::shared_ptr<decoder> decoder::factory::create(evm2_code& code, uint32_t entry_point = 0)
@@ -1,22 +1,51 @@
 #pragma once
-#include <boost/dynamic_bitset/dynamic_bitset.hpp>
 #include "evm2_types.h"
 #include "evm2_op_code.h"
 
+constexpr auto evm2_max_arguments = 4;
+
+enum argument_access : uint8_t
+{
+	register_access,
+	byte_access,
+	word_access,
+	dword_access,
+	qword_access
+};
+
+// Instruction argument packed into one byte: 0aaa rrrr
+//   aaa  - argument_access: register or memory access of 1, 2, 4 or 8 bytes
+//   rrrr - register number
 struct instruction_argument
 {
-	bool is_memory_access;      // if (true) memory will be accessed, otherwise register
-	uint8_t memory_access_size; // 1,2,4 or 8 bytes
-	uint8_t register_number;	
+	uint8_t value = 0;
+
+	instruction_argument() = default;
+	instruction_argument(bool is_memory_access, uint8_t memory_access_size, uint8_t register_number)
+		: value(static_cast<uint8_t>((is_memory_access ? memory_access_size + 1 : 0) << 4 | (register_number & 0xf))) {}
+
+	uint8_t access() const { return value >> 4; }
+	bool is_memory_access() const { return access() != register_access; }
+	uint8_t memory_access_size() const { return is_memory_access() ? access() - 1 : 0; } // log2 of size in bytes
+	uint8_t register_number() const { return value & 0xf; }
 };
 
+// Decoded instruction, fixed size and allocation free.
 struct evm2_instruction
 {
-	uint32_t address = 0; // if decoded: jmp/je address
-	int64_t constant = 0; // if decoded: 64-bit const value
-	std::vector<instruction_argument> arguments; // instruction arguments
+	union
+	{
+		int64_t constant = 0; // if decoded: 64-bit const value
+		uint32_t address;     // if decoded: jmp/je/call/createThread address
+	};
+	instruction_argument arguments[evm2_max_arguments]; // instruction arguments
+	evm2_op_code op_code = padding;
+	uint8_t length = 0;          // instruction length in bits
+	uint8_t arguments_count = 0;
 };
 
+static_assert(sizeof(evm2_instruction) <= 16, "evm2_instruction should fit 16 bytes");
+
 class decoder
 {
 	uint32_t c;            // internal decoder position (bit in instruction stream)
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Program code packed into 64-bit words.
+// Bit n of the instruction stream is bit (n % 64) of word (n / 64), so a field
+// starting at any bit position comes out of a single 64-bit window with a shift
+// and a mask. The stream is followed by zero guard words, an instruction which
+// overruns the code end reads zeroes instead of touching foreign memory.
+class evm2_code
+{
+	static constexpr size_t guard_words = 3;
+
+	std::vector<uint64_t> words;
+	size_t size_in_bits = 0;
+	size_t last_bit = 0;              // see find_last
+
+	static constexpr uint8_t reversed_bits(uint8_t value)
+	{
+		return static_cast<uint8_t>((value * 0x0202020202ULL & 0x010884422010ULL) % 1023);
+	}
+
+public:
+	evm2_code() = default;
+
+	// bytes are expected in stream order: first bit of the stream is bit 0 of bytes[0]
+	evm2_code(const uint8_t* bytes, size_t count)
+		: words((count + 7) / 8 + guard_words, 0), size_in_bits(8 * count)
+	{
+		for (size_t i = 0; i < count; i++)
+			words[i / 8] |= static_cast<uint64_t>(bytes[i]) << (8 * (i % 8));
+		last_bit = scan_last();
+	}
+
+	// packed words as returned by data(), e.g. from an image cache
+	evm2_code(const uint64_t* packed, size_t size_in_bits, size_t last_bit)
+		: words(packed, packed + word_count_for(size_in_bits)), size_in_bits(size_in_bits), last_bit(last_bit)
+	{
+		words.resize(words.size() + guard_words, 0);
+	}
+
+	// bytes as stored in an image: the stream starts with the most significant bit of bytes[0]
+	static evm2_code from_image(const uint8_t* bytes, size_t count)
+	{
+		evm2_code code;
+		code.words.assign((count + 7) / 8 + guard_words, 0);
+		code.size_in_bits = 8 * count;
+		for (size_t i = 0; i < count; i++)
+			code.words[i / 8] |= static_cast<uint64_t>(reversed_bits(bytes[i])) << (8 * (i % 8));
+		code.last_bit = code.scan_last();
+		return code;
+	}
+
+	size_t size() const { return size_in_bits; }
+
+	// packed stream without the guard words
+	const uint64_t* data() const { return words.data(); }
+	static size_t word_count_for(size_t size_in_bits) { return (size_in_bits + 63) / 64; }
+
+	bool operator[](size_t position) const
+	{
+		return (words[position >> 6] >> (position & 63)) & 1;
+	}
+
+	// 64 bits of the stream starting at position
+	uint64_t window(size_t position) const
+	{
+		const auto word = position >> 6;
+		const auto shift = position & 63;
+		if (!shift)
+			return words[word];
+		return words[word] >> shift | words[word + 1] << (64 - shift);
+	}
+
+	// count (1..64) bits starting at position, first stream bit is the least significant one
+	uint64_t bits(size_t position, int count) const
+	{
+		const auto value = window(position);
+		return count < 64 ? value & ((1ull << count) - 1) : value;
+	}
+
+	// FNV-1a of the stream, identifies the image a translation was made for
+	uint64_t hash() const
+	{
+		auto result = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < (size_in_bits + 7) / 8; i++)
+			result = (result ^ (words[i / 8] >> (8 * (i % 8)) & 0xff)) * 0x100000001b3ull;
+		return result;
+	}
+
+	// position of the last set bit of the stream (0 if there is none)
+	size_t find_last() const { return last_bit; }
+
+private:
+	size_t scan_last() const
+	{
+		for (auto word = (size_in_bits + 63) / 64; word-- > 0;)
+			for (auto bit = 64; words[word] && bit-- > 0;)
+				if (words[word] >> bit & 1)
+					return word * 64 + bit;
+		return 0;
+	}
+};
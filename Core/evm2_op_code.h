@@ -1,6 +1,7 @@
 #pragma once
+#include <cstdint>
 
-enum evm2_op_code
+enum evm2_op_code : uint8_t
 {	      
 	mov,      // 000      mov arg1, arg2                   arg2 <- arg1
 	load_const,// 001      loadConst constant, arg1         arg1 < -constant
@@ -14,7 +15,7 @@ enum evm2_op_code
 	          //                                           arg3 <-  1 if arg1 > arg2
     jump_address,// 01101    jump address
 	jump_equal,// 01110    jumpEqual address, arg1, arg2    Move instruction pointer to address if arg1 == arg2
-	read,     // 10000    read arg1, arg2, arg3, arg4
+	bin_read, // 10000    read arg1, arg2, arg3, arg4
 	          //                                           Read from binary input file using
 		      //                                           arg1  offset in input file
 		      //                                           arg2  number of bytes to read
@@ -22,7 +23,7 @@ enum evm2_op_code
 		      //                                           After read operation, arg4 receives amount of bytes actually
 		      //                                           read  may be less than arg2, if not enough data exists in
 		      //                                           input file.
-	write,    // 10001 write arg1, arg2, arg3              Write to binary output file using
+	bin_write,// 10001 write arg1, arg2, arg3              Write to binary output file using
 		      //                                           arg1  offset in output file
 		      //                                           arg2  number of bytes to write
 		      //                                           arg3  memory address from which bytes will be written
@@ -38,7 +39,7 @@ enum evm2_op_code
 		      //                                           Threads will only be joined once.
 	halt,     // 10110 hlt                                 End current thread. If initial thread is ended,
 		      //                                           end whole program.
-	sleep,    // 10111 sleep arg1                          Delay execution of current thread by arg1 milliseconds.
+	thread_sleep,// 10111 sleep arg1                          Delay execution of current thread by arg1 milliseconds.
 	call,     // 1100 call address                         Store address of instruction after the call
 		      //                                           to internal stack and continue execution at address.
 	ret,      // 1101 ret                                  Take address from internal stack and continue execution from it.
@@ -49,5 +50,7 @@ enum evm2_op_code
 	ukn01111, // unimplemented 01111 instruction
 	ukn010000,// unimplemented 010000 instruction
 	padding,  // end of instruction stream detected
-	stopped   // task is stopped (pseudo-instruction)
+	stopped,  // task is stopped (pseudo-instruction)
+	yielded,  // time slice used up, task mode only (pseudo-instruction)
+	block_link// continue with the next cached block (pseudo-instruction)
 };
\ No newline at end of file
@@ -1,13 +1,13 @@
 #pragma once
 #include <cstdint>
-#include <boost/dynamic_bitset/dynamic_bitset.hpp>
+#include <vector>
+#include "evm2_code.h"
 
 constexpr auto evm2_registers_count = 16;
 constexpr auto evm_default_entry_point = 0;
 constexpr auto evm2_magic = "ESET-VM2";
 constexpr auto evm2_magic_size = 8;
 
-typedef boost::dynamic_bitset<uint8_t> evm2_code;
 typedef std::vector<int8_t> evm2_memory;
 typedef std::vector<int64_t> evm2_registers;
 typedef std::vector<uint32_t> evm2_stack;
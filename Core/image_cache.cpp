@@ -0,0 +1,128 @@
+#include "pch.h"
+
+namespace
+{
+	constexpr char cache_magic[8] = { 'E', 'V', 'M', '2', 'C', 'A', 'C', 'H' };
+	constexpr uint32_t cache_version = 2;
+
+	enum : uint32_t
+	{
+		valid_targets = 1,
+		known_op_codes = 2
+	};
+
+	// followed by the code words and the instruction records
+	struct cache_header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t record_size;
+		uint64_t image_hash;
+		uint64_t code_bits;
+		uint64_t padding_position;
+		uint32_t record_count;
+		uint32_t flags;
+	};
+}
+
+uint64_t image_cache::image_hash(const uint8_t* bytes, size_t count)
+{
+	const auto mix = [](uint64_t hash, uint64_t word)
+	{
+		hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+		return hash ^ hash >> 32;
+	};
+
+	auto result = 0xcbf29ce484222325ull ^ count;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof word);
+		result = mix(result, word);
+	}
+	uint64_t tail = 0;
+	std::memcpy(&tail, bytes + i, count - i);
+	return mix(result, tail);
+}
+
+bool image_cache::load(const std::string& file_name, uint64_t hash, evm2_code& code, std::shared_ptr<code_verifier>& verification)
+{
+	try
+	{
+		if (!boost::filesystem::exists(file_name) || boost::filesystem::file_size(file_name) < sizeof(cache_header))
+			return false;
+
+		const boost::interprocess::file_mapping file(file_name.c_str(), boost::interprocess::read_only);
+		const boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+		const auto* bytes = static_cast<const uint8_t*>(region.get_address());
+
+		cache_header header = {};
+		std::memcpy(&header, bytes, sizeof header);
+		if (std::memcmp(header.magic, cache_magic, sizeof cache_magic) != 0 ||
+			header.version != cache_version ||
+			header.record_size != sizeof(verified_instruction) ||
+			header.image_hash != hash)
+			return false;
+
+		const auto words = evm2_code::word_count_for(header.code_bits);
+		const auto expected_size = sizeof header + words * sizeof(uint64_t) +
+			static_cast<uint64_t>(header.record_count) * sizeof(verified_instruction);
+		if (region.get_size() < expected_size)
+			return false;
+
+		// the header is 8 byte aligned, so are the words and records of a mapping
+		const auto* packed = reinterpret_cast<const uint64_t*>(bytes + sizeof header);
+		const auto* records = reinterpret_cast<const verified_instruction*>(packed + words);
+
+		std::vector<verified_instruction> instructions(records, records + header.record_count);
+		for (const auto& instruction : instructions)
+			if (instruction.address >= header.code_bits)
+				return false;
+
+		code = evm2_code(packed, header.code_bits, header.padding_position);
+		verification = std::make_shared<code_verifier>(code.size(), std::move(instructions),
+			(header.flags & valid_targets) != 0, (header.flags & known_op_codes) != 0);
+		return true;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+void image_cache::save(const std::string& file_name, uint64_t hash, const evm2_code& code, const code_verifier& verification)
+{
+	const auto& instructions = verification.reachable_code();
+
+	cache_header header = {};
+	std::memcpy(header.magic, cache_magic, sizeof cache_magic);
+	header.version = cache_version;
+	header.record_size = sizeof(verified_instruction);
+	header.image_hash = hash;
+	header.code_bits = code.size();
+	header.padding_position = code.find_last();
+	header.record_count = static_cast<uint32_t>(instructions.size());
+	header.flags = (verification.targets_valid() ? uint32_t(valid_targets) : 0u) | (verification.op_codes_known() ? uint32_t(known_op_codes) : 0u);
+
+	// written under a temporary name, so a concurrent start never maps half a file
+	const auto temporary_name = file_name + ".tmp";
+	bool written;
+	{
+		std::ofstream file(temporary_name, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return;
+		file.write(reinterpret_cast<const char*>(&header), sizeof header);
+		file.write(reinterpret_cast<const char*>(code.data()),
+			evm2_code::word_count_for(code.size()) * sizeof(uint64_t));
+		file.write(reinterpret_cast<const char*>(instructions.data()),
+			instructions.size() * sizeof(verified_instruction));
+		written = static_cast<bool>(file);
+	}
+
+	boost::system::error_code error;
+	if (written)
+		boost::filesystem::rename(temporary_name, file_name, error);
+	if (!written || error)
+		boost::filesystem::remove(temporary_name, error);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "code_verifier.h"
+#include "evm2_types.h"
+
+// On-disk cache of the load time work for an image (.evmc next to the .evm).
+// Holds the bit-reversed code words, the padding position and the verified
+// instruction stream with its block boundaries, in host layout so they are
+// copied out of a read-only mapping as they are. A cached start skips the
+// verifier's walk and the decoding of the reachable code. It is keyed by a hash
+// of the image file, a stale or damaged cache is ignored and rewritten.
+struct image_cache
+{
+	static std::string file_name_for(const std::string& image_file_name) { return image_file_name + "c"; }
+
+	// of the whole image file, a 64 bit word per step
+	static uint64_t image_hash(const uint8_t*, size_t);
+
+	// false if the cache is missing or doesn't belong to the image
+	static bool load(const std::string&, uint64_t, evm2_code&, std::shared_ptr<code_verifier>&);
+
+	// best effort, an unwritable directory just means no cache
+	static void save(const std::string&, uint64_t, const evm2_code&, const code_verifier&);
+};
\ No newline at end of file
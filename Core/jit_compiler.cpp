@@ -0,0 +1,261 @@
+#include "pch.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+const bool jit_compiler::supported = true;
+#else
+const bool jit_compiler::supported = false;
+#endif
+
+namespace
+{
+	constexpr size_t chunk_size = 0x10000;
+
+	size_t page_size()
+	{
+#ifdef _WIN32
+		static const auto size = []
+		{
+			SYSTEM_INFO system_info;
+			GetSystemInfo(&system_info);
+			return static_cast<size_t>(system_info.dwPageSize);
+		}();
+#else
+		static const auto size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		return size;
+	}
+
+	// register holding the register file address - the first integer argument
+#ifdef _WIN32
+	constexpr uint8_t base_register = 1; // rcx
+#else
+	constexpr uint8_t base_register = 7; // rdi
+#endif
+
+	class emitter
+	{
+		std::vector<uint8_t>& code;
+
+		void bytes(std::initializer_list<uint8_t> values) { code.insert(code.end(), values); }
+
+		void imm32(uint32_t value)
+		{
+			for (auto i = 0; i < 4; i++)
+				bytes({ static_cast<uint8_t>(value >> 8 * i) });
+		}
+
+		// [base + 8 * register_number], reg field of modrm is r
+		void guest_register(uint8_t r, uint8_t register_number)
+		{
+			bytes({ static_cast<uint8_t>(0x40 | r << 3 | base_register), static_cast<uint8_t>(8 * register_number) });
+		}
+
+	public:
+		explicit emitter(std::vector<uint8_t>& code) : code(code) {}
+
+		// mov rax, guest register
+		void load(uint8_t register_number) { bytes({ 0x48, 0x8b }); guest_register(0, register_number); }
+
+		// mov guest register, rax
+		void store(uint8_t register_number) { bytes({ 0x48, 0x89 }); guest_register(0, register_number); }
+
+		// mov rax, imm64
+		void load_constant(int64_t value)
+		{
+			bytes({ 0x48, 0xb8 });
+			imm32(static_cast<uint32_t>(value));
+			imm32(static_cast<uint32_t>(static_cast<uint64_t>(value) >> 32));
+		}
+
+		void add(uint8_t register_number) { bytes({ 0x48, 0x03 }); guest_register(0, register_number); }
+		void sub(uint8_t register_number) { bytes({ 0x48, 0x2b }); guest_register(0, register_number); }
+		void mul(uint8_t register_number) { bytes({ 0x48, 0x0f, 0xaf }); guest_register(0, register_number); }
+		void cmp(uint8_t register_number) { bytes({ 0x48, 0x3b }); guest_register(0, register_number); }
+
+		// rax <- 1 if greater, -1 if less, 0 if equal (flags of a preceding cmp)
+		void compare_result()
+		{
+			bytes({ 0x0f, 0x9f, 0xc0 }); // setg al
+			bytes({ 0x0f, 0x9c, 0xc2 }); // setl dl
+			bytes({ 0x0f, 0xb6, 0xc0 }); // movzx eax, al
+			bytes({ 0x0f, 0xb6, 0xd2 }); // movzx edx, dl
+			bytes({ 0x48, 0x29, 0xd0 }); // sub rax, rdx
+		}
+
+		// return address to the interpreter
+		void leave(uint32_t address)
+		{
+			bytes({ 0xb8 }); // mov eax, imm32
+			imm32(address);
+			bytes({ 0xc3 }); // ret
+		}
+
+		// skip a following leave if the flags say not equal
+		void skip_leave_if_not_equal() { bytes({ 0x75, 0x06 }); } // jne +6
+	};
+
+	bool register_only(const evm2_instruction& instruction)
+	{
+		for (auto i = 0; i < instruction.arguments_count; i++)
+			if (instruction.arguments[i].is_memory_access())
+				return false;
+		return true;
+	}
+}
+
+bool jit_compiler::translate(const cached_instruction* instruction, std::vector<uint8_t>& code) const
+{
+	emitter emit(code);
+	auto translated = 0;
+
+	for (;; instruction++, translated++)
+	{
+		const auto& decoded = instruction->instruction;
+		const auto* arguments = decoded.arguments;
+
+		if (!register_only(decoded))
+		{
+			emit.leave(instruction->address);
+			break;
+		}
+
+		switch (decoded.op_code)
+		{
+			case load_const:
+				emit.load_constant(decoded.constant);
+				emit.store(arguments[0].register_number());
+				continue;
+
+			case mov:
+				emit.load(arguments[0].register_number());
+				emit.store(arguments[1].register_number());
+				continue;
+
+			case add:
+			case sub:
+			case mul:
+				emit.load(arguments[0].register_number());
+				if (decoded.op_code == add)
+					emit.add(arguments[1].register_number());
+				else if (decoded.op_code == sub)
+					emit.sub(arguments[1].register_number());
+				else
+					emit.mul(arguments[1].register_number());
+				emit.store(arguments[2].register_number());
+				continue;
+
+			case compare:
+				emit.load(arguments[0].register_number());
+				emit.cmp(arguments[1].register_number());
+				emit.compare_result();
+				emit.store(arguments[2].register_number());
+				continue;
+
+			case jump_address:
+				if (decoded.address >= code_size)
+				{
+					emit.leave(instruction->address); // let the interpreter throw
+					break;
+				}
+				emit.leave(decoded.address);
+				break;
+
+			case jump_equal:
+				if (decoded.address >= code_size)
+				{
+					emit.leave(instruction->address);
+					break;
+				}
+				emit.load(arguments[0].register_number());
+				emit.cmp(arguments[1].register_number());
+				emit.skip_leave_if_not_equal();
+				emit.leave(decoded.address);
+				continue; // with the block_link that follows
+
+			default: // block_link and instructions left to the interpreter
+				emit.leave(instruction->address);
+				break;
+		}
+		break;
+	}
+
+	return translated > 0;
+}
+
+// other threads run the blocks already installed, so a page is written once and then sealed read+exec -
+// each block starts on a page of its own and its pages never become writable again
+native_block jit_compiler::install(const std::vector<uint8_t>& code)
+{
+	const auto pages_size = (code.size() + page_size() - 1) & ~(page_size() - 1);
+	if (pages_size > chunk_size)
+		return nullptr;
+
+	if (chunks.empty() || chunks.back().size - chunks.back().used < pages_size)
+	{
+#ifdef _WIN32
+		auto* memory = static_cast<uint8_t*>(VirtualAlloc(nullptr, chunk_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+		if (!memory)
+			return nullptr;
+#else
+		auto* memory = static_cast<uint8_t*>(mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (memory == MAP_FAILED)
+			return nullptr;
+#endif
+		chunks.push_back({ memory, chunk_size, 0 });
+	}
+
+	auto& chunk = chunks.back();
+	auto* block = chunk.memory + chunk.used;
+	std::copy(code.begin(), code.end(), block);
+	chunk.used += pages_size;
+
+#ifdef _WIN32
+	DWORD old_protection;
+	if (!VirtualProtect(block, pages_size, PAGE_EXECUTE_READ, &old_protection))
+		return nullptr;
+	FlushInstructionCache(GetCurrentProcess(), block, code.size());
+#else
+	if (mprotect(block, pages_size, PROT_READ | PROT_EXEC) != 0)
+		return nullptr;
+#endif
+
+	return reinterpret_cast<native_block>(block);
+}
+
+void jit_compiler::compile(const cached_instruction& entry)
+{
+	if (!supported)
+		return;
+
+	std::lock_guard lock_guard(compile_mutex);
+	if (entry.native.load(std::memory_order_relaxed))
+		return;
+
+	std::vector<uint8_t> code;
+	if (translate(&entry, code))
+		entry.native.store(install(code), std::memory_order_release);
+}
+
+jit_compiler::jit_compiler(uint32_t code_size) : code_size(code_size) {}
+
+jit_compiler::~jit_compiler()
+{
+	for (const auto& chunk : chunks)
+#ifdef _WIN32
+		VirtualFree(chunk.memory, 0, MEM_RELEASE);
+#else
+		munmap(chunk.memory, chunk.size);
+#endif
+}
+
+std::shared_ptr<jit_compiler> jit_compiler::factory::create(uint32_t code_size)
+{
+	return std::make_shared<jit_compiler>(code_size);
+}
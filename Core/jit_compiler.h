@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "program.h"
+
+// x86-64 translation of hot basic blocks, shared by all threads of a process.
+// A block is translated once its entry has been reached jit_threshold times by
+// a control transfer of the threaded engine. Guest registers stay in the
+// machine register file, the translated block gets its address as the only
+// argument and returns the bit address to continue with. Translation stops at
+// the first instruction it can't handle (memory arguments, div/mod, call/ret,
+// I/O, threads, locks, sleep) and returns its address, so the interpreter
+// executes it.
+class jit_compiler
+{
+	struct executable_chunk
+	{
+		uint8_t* memory;
+		size_t size;
+		size_t used;
+	};
+
+	uint32_t code_size;                   // program size in bits, valid jump targets are below
+	std::vector<executable_chunk> chunks;
+	std::mutex compile_mutex;             // guards chunks and publishing of native blocks
+
+	native_block install(const std::vector<uint8_t>&);
+	bool translate(const cached_instruction*, std::vector<uint8_t>&) const;
+
+public:
+	static constexpr uint32_t jit_threshold = 64;
+	static const bool supported;          // false on anything but x86-64
+
+	explicit jit_compiler(uint32_t);
+	~jit_compiler();
+	jit_compiler(const jit_compiler&) = delete;
+	jit_compiler& operator=(const jit_compiler&) = delete;
+
+	// counts execution of a block entry, translates it when it gets hot,
+	// returns true if the entry has a native block
+	// (the counter isn't a read-modify-write - lost counts between threads only delay translation)
+	bool hot(const cached_instruction& entry)
+	{
+		if (entry.native.load(std::memory_order_acquire))
+			return true;
+		const auto executions = entry.executions.load(std::memory_order_relaxed) + 1;
+		entry.executions.store(executions, std::memory_order_relaxed);
+		if (executions != jit_threshold)
+			return false;
+		compile(entry);
+		return entry.native.load(std::memory_order_acquire) != nullptr;
+	}
+
+	void compile(const cached_instruction&);
+
+	struct factory
+	{
+		static std::shared_ptr<jit_compiler> create(uint32_t);
+	};
+};
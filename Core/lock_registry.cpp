@@ -0,0 +1,33 @@
+#include "pch.h"
+
+lock_registry::lock_registry()
+	: buckets(std::make_unique<std::atomic<guest_lock*>[]>(size_t(1) << bucket_bits)) {}
+
+lock_registry::~lock_registry()
+{
+	for (size_t i = 0; i < size_t(1) << bucket_bits; i++)
+		for (auto* lock = buckets[i].load(std::memory_order_relaxed); lock;)
+			delete std::exchange(lock, lock->next);
+}
+
+guest_lock& lock_registry::find(uint64_t index)
+{
+	auto& bucket = buckets[bucket_of(index)];
+	auto* head = bucket.load(std::memory_order_acquire);
+	for (auto* lock = head; lock; lock = lock->next)
+		if (lock->index == index)
+			return *lock;
+
+	auto created = std::make_unique<guest_lock>(index);
+	for (;;)
+	{
+		created->next = head;
+		if (bucket.compare_exchange_weak(head, created.get(), std::memory_order_release, std::memory_order_acquire))
+			return *created.release();
+
+		// the bucket changed - the same lock may have been created meanwhile
+		for (auto* lock = head; lock != created->next; lock = lock->next)
+			if (lock->index == index)
+				return *lock;
+	}
+}
\ No newline at end of file
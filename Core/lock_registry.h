@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Guest lock. The owner word is the whole uncontended protocol - lock and
+// unlock are one atomic operation each. Threads which find the lock taken
+// queue up in parked, first come first served: unlock hands the lock to the
+// first of them, which is unparked as its owner.
+struct guest_lock
+{
+	static constexpr int64_t free = -1;
+
+	const uint64_t index;
+	std::atomic<int64_t> owner{ free };   // thread id of the owner
+	std::atomic<uint32_t> waiting{ 0 };   // threads on the contended path, unlock looks at it after the release
+
+	std::mutex mutex;                     // contended path
+	std::deque<uint64_t> parked;          // waiting thread ids in arrival order
+
+	guest_lock* next = nullptr;           // lock_registry bucket chain
+
+	explicit guest_lock(uint64_t index) : index(index) {}
+
+	// true if thread got the lock, holder is the current owner otherwise
+	bool try_acquire(int64_t thread, int64_t& holder)
+	{
+		holder = free;
+		return owner.compare_exchange_strong(holder, thread);
+	}
+
+	// returns the previous owner, free if the lock wasn't locked
+	int64_t release() { return owner.exchange(free); }
+};
+
+// Locks of a process by index, created on first use and kept to the end.
+// Lookup walks one bucket chain without taking a lock, a new lock is pushed
+// to its bucket with a CAS.
+class lock_registry
+{
+	static constexpr size_t bucket_bits = 10;
+
+	std::unique_ptr<std::atomic<guest_lock*>[]> buckets;
+
+	static size_t bucket_of(uint64_t index) { return (index * 0x9e3779b97f4a7c15ull) >> (64 - bucket_bits); }
+
+public:
+	lock_registry();
+	~lock_registry();
+	lock_registry(const lock_registry&) = delete;
+	lock_registry& operator=(const lock_registry&) = delete;
+
+	guest_lock& find(uint64_t);
+};
\ No newline at end of file
@@ -2,60 +2,69 @@
 
 evm2_op_code machine::Run()
 {
-	while(can_run())
+	if (engine != dispatch_engine::switch_loop)
+		return threaded_engine::run(*this);
+
+	slice_left = time_slice;
+	budget = 1;
+	while(checkpoint())
 	{
-		switch (const auto op_code = decoder->fetch()) {
+		const auto& instruction = code->at(instruction_pointer);
+		current = &instruction.instruction;
+		instruction_pointer += current->length;
+
+		switch (const auto op_code = current->op_code) {
 
 			case load_const: 
-				arg1 = decoder->instruction.constant;
+				arg<0>(current->constant);
 				break;
 			
 			case mov: 
-				arg2 = static_cast<int64_t>(arg1);
+				arg<1>(arg<0>());
 				break;
 
 			case add: 
-				arg3 = arg1 + arg2;
+				binary(*current, std::plus<int64_t>());
 				break;
 			
 			case sub:
-				arg3 = arg1 - arg2;
+				binary(*current, std::minus<int64_t>());
 				break;
 			
 			case divide:
-				arg3 = arg1 / arg2;
+				binary(*current, std::divides<int64_t>());
 				break;
 
 			case mod:
-				arg3 = arg1 % arg2;
+				binary(*current, std::modulus<int64_t>());
 				break;
 
 			case mul:
-				arg3 = arg1 * arg2;
+				binary(*current, std::multiplies<int64_t>());
 				break;
 			
 			case compare:
-				arg3 = arg1 == arg2 ? 0 : arg1 > arg2 ? 1 : -1;
+				binary(*current, compare_operation());
 				break;
 
 			case jump_address: 
-				decoder->jump(decoder->instruction.address);
+				jump(instruction);
 				break;
 			
 			case jump_equal:
-				if (arg1 == arg2)
-					decoder->jump(decoder->instruction.address);
+				if (arg<0>() == arg<1>())
+					jump(instruction);
 				break;
 
 			case call:
-				stack[--stack_position] = decoder->get_address();
+				stack[--stack_position] = instruction_pointer;
 				if (stack_position == 0)
 					throw out_of_range_exception("Stack overflow");
-				decoder->jump(decoder->instruction.address);
+				jump(instruction);
 				break;
 
 			case ret:
-				decoder->jump(stack[stack_position++]);
+				jump(stack[stack_position++]);
 				break;
 			
 			default:
@@ -63,18 +72,16 @@ evm2_op_code machine::Run()
 		}
 	}
 	
-	return stopped;
+	return exit_op_code;
 }
 
-machine::machine(evm2_code& code, evm2_memory& memory, uint32_t entry_point)
-	:code(code), memory(memory), stack(0x1000, 0), stack_position(0x0fff), registers(evm2_registers_count, 0)
-{
-	decoder = decoder::factory::create(code, entry_point);
-}
+machine::machine(std::shared_ptr<const program> code, evm2_memory& memory, uint32_t entry_point)
+	:code(std::move(code)), memory(memory), stack(0x1000, 0), stack_position(0x0fff), registers(evm2_registers_count, 0),
+	instruction_pointer(entry_point), current(nullptr) {}
 
-std::shared_ptr<machine> machine::factory::create(evm2_code& code, evm2_memory& memory)
+std::shared_ptr<machine> machine::factory::create(std::shared_ptr<const program> code, evm2_memory& memory)
 {
-	return std::make_shared<machine>(code, memory, evm_default_entry_point);
+	return std::make_shared<machine>(std::move(code), memory, evm_default_entry_point);
 }
 
 std::shared_ptr<machine> machine::factory::duplicate(const std::shared_ptr<machine>& source, uint32_t entryPoint)
@@ -84,51 +91,20 @@ std::shared_ptr<machine> machine::factory::duplicate(const std::shared_ptr<machi
 	return result;
 }
 
-int64_t machine::read(instruction_argument& argument)
+void machine::restart(const machine& parent, uint32_t entry_point)
 {
-	if (argument.is_memory_access)
-	{
-		uint64_t result = 0;
-		for (int64_t i = (1l << argument.memory_access_size) - 1l; i >= 0; i--)
-		{
-			result = result << 8;
-
-			if (argument.register_number >= evm2_registers_count)
-				throw out_of_range_exception("Access register out of range");
-
-			if (registers[argument.register_number] + i >= static_cast<int64_t>(memory.size()))
-				throw out_of_range_exception("Write memory out of range");
-
-			result += static_cast<uint8_t>(memory[registers[argument.register_number] + i]);
-		}
-		return result;
-	}
-
-	if (argument.register_number >= evm2_registers_count)
-		throw out_of_range_exception("Access register out of range");
-
-	return registers[argument.register_number];
+	std::copy(parent.registers.begin(), parent.registers.end(), registers.begin());
+	stack_position = 0x0fff;
+	stack[stack_position] = 0;
+	instruction_pointer = entry_point;
+	current = nullptr;
+	exit_op_code = stopped;
 }
 
-void machine::write(instruction_argument& argument, int64_t value)
+void machine::jump(uint32_t new_address)
 {
-	if (argument.register_number >= evm2_registers_count)
-		throw out_of_range_exception("Access register out of range");
-
-	if (argument.is_memory_access)
-	{
-		for (auto i = 0; i < 1 << argument.memory_access_size; i++)
-		{
-			const size_t address = registers[argument.register_number] + i;
-
-			if (address >= memory.size())
-				throw out_of_range_exception("Read memory out of range");
+	if (new_address >= code->size())
+		throw out_of_range_exception("Instruction call/jump/jumpEqual out of range exception");
 
-			memory[address] = static_cast<int8_t>(value & 0xff);
-			value = value >> 8;
-		}
-		return;
-	}
-
-	registers[argument.register_number] = value;
-}
+	instruction_pointer = new_address;
+}
\ No newline at end of file
@@ -1,79 +1,195 @@
 #pragma once
+#include <cstring>
 #include <memory>
 #include <vector>
-#include "misc.h"
 #include "decoder.h"
+#include "program.h"
+#include "jit_compiler.h"
+#include "aot_module.h"
 #include "evm2_types.h"
 #include "stoppable_task.h"
+#include "exception.h"
+
+enum class dispatch_engine
+{
+	switch_loop, // decode-and-switch loop, returns to the caller for I/O, thread and lock instructions
+	threaded,    // direct threaded handlers, see threaded_engine
+	jit          // threaded engine with x86-64 translation of hot blocks, see jit_compiler
+};
+
+class machine;
+
+// compare arg1, arg2, arg3: -1 if arg1 < arg2, 0 if equal, 1 if arg1 > arg2
+struct compare_operation
+{
+	int64_t operator()(int64_t a, int64_t b) const { return a == b ? 0 : a > b ? 1 : -1; }
+};
+
+// Executes instructions the machine can't execute itself - I/O, threads, locks and sleep.
+class machine_host
+{
+public:
+	virtual ~machine_host() = default;
+
+	// returns false if the instruction should be returned to the caller of machine::Run instead
+	virtual bool execute(machine&, evm2_op_code) = 0;
+};
 
 class machine : public stoppable_task
 {
-	evm2_code& code;
+	std::shared_ptr<const program> code;
 	evm2_memory& memory;	
 	evm2_stack stack;
 	uint32_t stack_position;
 	evm2_registers registers;
 	
-	std::shared_ptr<decoder> decoder;
+	uint32_t instruction_pointer;           // bit address of the next instruction
+	const evm2_instruction* current;        // instruction being executed
+	evm2_op_code exit_op_code = stopped;    // instruction Run returns with when an engine leaves
+	uint32_t slice_left = 0;                // stop request checks left in this Run, see time_slice
+	uint32_t budget = 1;                    // instructions or transfers left before the next check, see checkpoint
 
-	int64_t read(instruction_argument&);
-	void write(instruction_argument&, int64_t);
+	template<uint8_t access> int64_t load(instruction_argument);
+	template<uint8_t access> void store(instruction_argument, int64_t);
+	int64_t read(instruction_argument);
+	void write(instruction_argument, int64_t);
+	template<typename operation> void binary(const evm2_instruction&, operation);
+	void jump(uint32_t);
+	void jump(const cached_instruction&);
+	bool checkpoint();
 	
 	friend class thread;
 	friend class process;
+	friend struct threaded_engine;
+	friend struct threaded_handlers;
+	friend class aot_module;
 public:
+	dispatch_engine engine = dispatch_engine::switch_loop;
+	machine_host* host = nullptr;       // used by the threaded engine only
+	std::shared_ptr<jit_compiler> jit;  // used by the threaded engine only
+	std::shared_ptr<aot_module> native; // used by the threaded engine only
+	uint32_t time_slice = 0;            // Run returns yielded after that many stop request checks, 0 = no limit
+
+	// instructions (switch loop) or control transfers (threaded engine) between stop request checks
+	static constexpr uint32_t check_interval = 256;
 
-	machine(evm2_code&, evm2_memory&, uint32_t);
+	machine(std::shared_ptr<const program>, evm2_memory&, uint32_t);
 	
 	evm2_op_code Run();
+	void restart(const machine&, uint32_t); // reuses stack and registers, see thread::restart
 
 	struct factory
 	{
-		static std::shared_ptr<machine> create(evm2_code&, evm2_memory&);
+		static std::shared_ptr<machine> create(std::shared_ptr<const program>, evm2_memory&);
 		static std::shared_ptr<machine> duplicate(const std::shared_ptr<machine>&, uint32_t);
 	};
 
-	property<int64_t> arg1 {
-		[this](int64_t value)
-		{
-			this->write(decoder->instruction.arguments[0], value);
-		},
-		[this]() -> int64_t
-		{
-			return this->read(decoder->instruction.arguments[0]);
-		}
-	};
+	// instruction argument n (0 based) of the current instruction
+	template<int n> int64_t arg() { return read(current->arguments[n]); }
+	template<int n> void arg(int64_t value) { write(current->arguments[n], value); }
+};
 
-	property<int64_t> arg2 {
-	[this](int64_t value)
-		{
-			this->write(decoder->instruction.arguments[1], value);
-		},
-		[this]() -> int64_t
-		{
-			return this->read(decoder->instruction.arguments[1]);
-		}
-	};
+// target of a jump, jumpEqual or call - range checked unless the verifier proved it
+inline void machine::jump(const cached_instruction& instruction)
+{
+	if (instruction.target_verified)
+		instruction_pointer = instruction.instruction.address;
+	else
+		jump(instruction.instruction.address);
+}
 
-	property<int64_t> arg3 {
-	[this](int64_t value)
-		{
-			this->write(decoder->instruction.arguments[2], value);
-		},
-		[this]() -> int64_t
-		{
-			return this->read(decoder->instruction.arguments[2]);
-		}
-	};
+// stop request and time slice, checked once per check_interval calls and on the
+// first one of a Run; false if Run has to return exit_op_code
+inline bool machine::checkpoint()
+{
+	if (--budget)
+		return true;
+	budget = check_interval;
 
-	property<int64_t> Arg4 {
-	[this](int64_t value)
-		{
-		this->write(decoder->instruction.arguments[3], value);
-		},
-	[this]() -> int64_t
-		{
-			return this->read(decoder->instruction.arguments[3]);
-		}
-	};
-};
+	if (!can_run())
+		exit_op_code = stopped;
+	else if (slice_left && !--slice_left)
+		exit_op_code = yielded;
+	else
+		return true;
+	return false;
+}
+
+// memory operands - one range check, then a little-endian access of the exact width
+// (memcpy of the low bytes, the host is little-endian)
+template<uint8_t access>
+int64_t machine::load(instruction_argument argument)
+{
+	if constexpr (access == register_access)
+		return registers[argument.register_number()];
+	else
+	{
+		constexpr int64_t size = 1 << (access - 1);
+		const auto address = registers[argument.register_number()];
+		if (address < 0 || address > static_cast<int64_t>(memory.size()) - size)
+			throw out_of_range_exception("Write memory out of range");
+
+		uint64_t result = 0;
+		std::memcpy(&result, memory.data() + address, size);
+		return static_cast<int64_t>(result);
+	}
+}
+
+template<uint8_t access>
+void machine::store(instruction_argument argument, int64_t value)
+{
+	if constexpr (access == register_access)
+		registers[argument.register_number()] = value;
+	else
+	{
+		constexpr int64_t size = 1 << (access - 1);
+		const auto address = registers[argument.register_number()];
+		if (address < 0 || address > static_cast<int64_t>(memory.size()) - size)
+			throw out_of_range_exception("Read memory out of range");
+
+		std::memcpy(memory.data() + address, &value, size);
+	}
+}
+
+inline int64_t machine::read(instruction_argument argument)
+{
+	switch (argument.access())
+	{
+		case byte_access:  return load<byte_access>(argument);
+		case word_access:  return load<word_access>(argument);
+		case dword_access: return load<dword_access>(argument);
+		case qword_access: return load<qword_access>(argument);
+		default:           return load<register_access>(argument);
+	}
+}
+
+inline void machine::write(instruction_argument argument, int64_t value)
+{
+	switch (argument.access())
+	{
+		case byte_access:  return store<byte_access>(argument, value);
+		case word_access:  return store<word_access>(argument, value);
+		case dword_access: return store<dword_access>(argument, value);
+		case qword_access: return store<qword_access>(argument, value);
+		default:           return store<register_access>(argument, value);
+	}
+}
+
+// arg3 <- operation(arg1, arg2)
+template<typename operation>
+void machine::binary(const evm2_instruction& instruction, operation op)
+{
+	const auto* arguments = instruction.arguments;
+
+	// register only form - the usual output of the compiler
+	if (((arguments[0].value | arguments[1].value | arguments[2].value) >> 4) == register_access)
+	{
+		registers[arguments[2].register_number()] = op(
+			registers[arguments[0].register_number()],
+			registers[arguments[1].register_number()]);
+		return;
+	}
+
+	const auto value = op(read(arguments[0]), read(arguments[1]));
+	write(arguments[2], value);
+}
\ No newline at end of file
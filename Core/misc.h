@@ -25,20 +25,3 @@ bool foreach_no_except(list&& items, predicate&& _predicate)
 	}
 	return result;
 }
-
-
-template<typename T>
-class property {
-public:
-	property(
-		std::function<void(T)> setter,
-		std::function<T()> getter) :
-		Setter(setter), Getter(getter) { }
-	operator T() const { return Getter(); }
-	property<T>& operator= (const T& value) { Setter(value); return *this; }
-	T& Value() { return value; }
-private:
-	std::function<void(T)> Setter;
-	std::function<T()> Getter;
-	T value;
-};
\ No newline at end of file
@@ -14,17 +14,31 @@
 
 #include <boost/thread.hpp>
 #include <boost/format.hpp>
-#include <boost/dynamic_bitset.hpp>
 #include <boost/filesystem.hpp>
-
-#include <concurrent_vector.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include "evm2_op_code.h"
+#include "evm2_code.h"
 #include "evm2_types.h"
 #include "misc.h"
 #include "stoppable_task.h"
+#include "timer_queue.h"
 #include "exception.h"
 #include "decoder.h"
+#include "code_verifier.h"
+#include "image_cache.h"
+#include "program.h"
+#include "threaded_engine.h"
+#include "jit_compiler.h"
+#include "aot_context.h"
+#include "aot_translator.h"
+#include "aot_module.h"
+#include "binary_file.h"
+#include "console_output.h"
+#include "lock_registry.h"
+#include "scheduler.h"
+#include "segmented_vector.h"
 #include "machine.h"
 #include "thread.h"
 #include "process.h"
@@ -1,92 +1,265 @@
 #include "pch.h"
 
-using bytes_buffer = std::vector<uint8_t>;
+namespace
+{
+	// one range check for a whole file transfer
+	void check_memory_range(const evm2_memory& memory, size_t address, size_t count, const char* message)
+	{
+		if (address > memory.size() || count > memory.size() - address)
+			throw out_of_range_exception(message);
+	}
+
+	// instructions a task doesn't execute in place, it may have to be parked for them
+	bool may_block(evm2_op_code op_code)
+	{
+		return op_code == thread_sleep || op_code == thread_join || op_code == lock;
+	}
+}
 
 void process::start()
 {
+	if (engine == dispatch_engine::jit)
+		jit = jit_compiler::factory::create(static_cast<uint32_t>(code.size()));
+	timers = timer_queue::factory::create();
+	console.interactive = interactive_console;
+
 	const auto main_thread = std::make_shared<thread_item>();
-	main_thread->evm2_thread = thread::factory::create_main_thread(code, memory);
+	main_thread->evm2_thread = thread::factory::create_main_thread(decoded_code, memory);
 	thread_table.push_back(main_thread);
 
 	if (!binary_file_name.empty())
 	{
-		auto open_mode = std::ios::in | std::ios::out | std::ios::binary;
-		if (!boost::filesystem::exists(binary_file_name))
-			open_mode |= std::ios::trunc;		
-		binary_file.open(binary_file_name, open_mode);
-		binary_file.unsetf(std::ios::skipws);
+		file = binary_file::factory::create(binary_file_name, map_binary_file);
+		if (file)
+			file->timers = timers;
+	}
+
+	if (threads == thread_model::tasks)
+	{
+		task_scheduler = scheduler::factory::create([this](uint64_t thread_id) { run_task(thread_id); }, timers, workers);
+		prepare_task(main_thread, 0);
+		task_scheduler->run(0);
+		release();
+		if (task_failure)
+			std::rethrow_exception(task_failure);
+		return;
 	}
 	
 	run(0);
 }
 
+void process::attach(thread& thread, machine_host& host)
+{
+	thread.timers = timers;
+	thread.console = &console;
+
+	auto& machine = *thread.machine;
+	machine.engine = native && engine == dispatch_engine::switch_loop ? dispatch_engine::threaded : engine;
+	machine.host = &host;
+	machine.native = native;
+	machine.jit = jit;
+}
+
 void process::run(uint64_t thread_id)
 {
 	const auto thread = thread_table[thread_id]->evm2_thread;
+	thread_host host(*this, thread, thread_id);
+	attach(*thread, host);
+
 	while (can_run())
 	{
 		try
 		{
-			switch (const auto op_code = thread->run())
-			{			
-				case thread_create:
-					thread->machine->arg1 = 
-						create_thread(thread, thread->machine->decoder->instruction.address);
-					break;
+			const auto op_code = thread->run();
+			if (host.failure)
+				std::rethrow_exception(host.failure);
+			if (!execute(thread, thread_id, op_code))
+				return hlt(thread_id);
+		}	
+		catch (...)
+		{
+			hlt(thread_id);
+			throw;
+		}
+	}
+	hlt(thread_id);
+}
 
-				case thread_join:
-					join_thread(thread->machine->arg1);
-					break;
+void process::prepare_task(const std::shared_ptr<thread_item>& item, uint64_t thread_id)
+{
+	auto host = std::make_shared<thread_host>(*this, item->evm2_thread, thread_id);
+	attach(*item->evm2_thread, *host);
+	item->evm2_thread->machine->time_slice = scheduler::time_slice;
+	item->evm2_thread->cooperative = true;
+	item->host = std::move(host);
+}
 
-				case read:
-					thread->machine->Arg4 = file_read(
-						thread->machine->arg1,
-						thread->machine->arg2,
-						thread->machine->arg3);
-					break;
+// one step of a task - runs the guest thread until it ends, yields or has to wait
+void process::run_task(uint64_t thread_id)
+{
+	const auto item = thread_table[thread_id];
+	const auto thread = item->evm2_thread;
+	const auto& host = static_cast<thread_host&>(*item->host);
 
-				case write:
-					file_write(
-						thread->machine->arg1,
-						thread->machine->arg2,
-						thread->machine->arg3);
-					break;
+	try
+	{
+		for (;;)
+		{
+			const auto op_code = thread->run();
+			if (host.failure)
+				std::rethrow_exception(host.failure);
 
-				case con_read:
-					thread->machine->arg1 = console_read();
-					break;
+			switch (op_code)
+			{
+				case yielded:
+					return task_scheduler->yield(thread_id);
 
-				case con_write:
-					console_write(thread->machine->arg1);
-					break;
+				case thread_sleep:
+					return task_scheduler->submit_at(thread_id, timer_queue::deadline_after(thread->machine->arg<0>()));
 
-				case lock: 
-					process_lock(thread->machine->arg1, thread_id);
+				case thread_join:
+					if (!join_task(thread->machine->arg<0>(), thread_id))
+						return; // parked until the joined task ends
 					break;
 
-				case unlock: 
-					process_unlock(thread->machine->arg1, thread_id);
+				case lock:
+					if (!lock_task(thread->machine->arg<0>(), thread_id))
+						return; // parked until the lock is handed over
 					break;
 
-				case halt:
-				case padding:
-				case stopped:
-					return hlt(thread_id);
-				
 				default:
-					// default case means sth wasn't implemented or was bad refactored
-					throw not_implemented_exception("Unimplemented instruction");
+					if (!execute(thread, thread_id, op_code))
+						return end_task(thread_id);
 			}
-		}	
-		catch (...)
+		}
+	}
+	catch (...)
+	{
 		{
-			hlt(thread_id);
-			throw;
+			std::lock_guard lock_guard(task_failure_mutex);
+			if (!task_failure)
+				task_failure = std::current_exception();
 		}
+		end_task(thread_id);
+		terminate();
+	}
+}
+
+void process::end_task(uint64_t thread_id)
+{
+	const auto item = thread_table[thread_id];
+	int64_t joiner;
+	{
+		std::lock_guard lock_guard(item->task_mutex);
+		item->finished = true;
+		joiner = item->joiner;
+		if (joiner >= 0)
+			free_slot(thread_id);
 	}
+	if (joiner >= 0)
+		task_scheduler->submit(joiner);
 	hlt(thread_id);
 }
 
+// false if the joining task was parked
+bool process::join_task(uint64_t thread_to_join, uint64_t thread_id)
+{
+	if (thread_to_join >= thread_table.size())
+		throw out_of_range_exception("Invalid join thread argument");
+
+	const auto item = thread_table[thread_to_join];
+	std::lock_guard lock_guard(item->task_mutex);
+	if (item->joined)
+		throw not_implemented_exception("Threads should be joined once");
+
+	item->joined = true;
+	if (item->finished)
+	{
+		free_slot(thread_to_join);
+		return true;
+	}
+	item->joiner = static_cast<int64_t>(thread_id);
+	return false;
+}
+
+bool process::execute(const std::shared_ptr<thread>& thread, uint64_t thread_id, evm2_op_code op_code)
+{
+	switch (op_code)
+	{			
+		case thread_create:
+			thread->machine->arg<0>(
+				create_thread(thread, thread->machine->current->address));
+			return true;
+
+		case thread_join:
+			join_thread(thread->machine->arg<0>());
+			return true;
+
+		case bin_read:
+			thread->machine->arg<3>(file_read(
+				thread->machine->arg<0>(),
+				thread->machine->arg<1>(),
+				thread->machine->arg<2>()));
+			return true;
+
+		case bin_write:
+			file_write(
+				thread->machine->arg<0>(),
+				thread->machine->arg<1>(),
+				thread->machine->arg<2>());
+			return true;
+
+		case con_read:
+			thread->machine->arg<0>(console_read());
+			return true;
+
+		case con_write:
+			console_write(thread->machine->arg<0>());
+			return true;
+
+		case lock: 
+			process_lock(thread->machine->arg<0>(), thread_id);
+			return true;
+
+		case unlock: 
+			process_unlock(thread->machine->arg<0>());
+			return true;
+
+		case thread_sleep: // threaded engine only, thread::run handles it otherwise
+			thread->sleep(thread->machine->arg<0>());
+			return true;
+
+		case halt:
+		case padding:
+		case stopped:
+			return false;
+		
+		default:
+			// default case means sth wasn't implemented or was bad refactored
+			throw not_implemented_exception("Unimplemented instruction");
+	}
+}
+
+process::thread_host::thread_host(process& owner, std::shared_ptr<thread> evm2_thread, uint64_t thread_id)
+	: owner(owner), evm2_thread(std::move(evm2_thread)), thread_id(thread_id) {}
+
+bool process::thread_host::execute(machine& machine, evm2_op_code op_code)
+{
+	if (owner.task_scheduler && may_block(op_code))
+		return false; // see process::run_task
+
+	try
+	{
+		return owner.execute(evm2_thread, thread_id, op_code);
+	}
+	catch (...)
+	{
+		failure = std::current_exception();
+		machine.stop();
+		return true;
+	}
+}
+
 void process::hlt(uint64_t thread_ix)
 {
 	if (thread_ix == 0) // thread_ix 0 means main thread
@@ -98,10 +271,18 @@ void process::stop()
 	stoppable_task::stop();
 	if (thread_table[0] && thread_table[0]->evm2_thread)
 		thread_table[0]->evm2_thread->stop();
+	if (task_scheduler)
+		task_scheduler->stop(); // parked tasks never run again, start releases them
 }
 
 void process::terminate() noexcept
 {
+	// one broadcast before anything is joined - sleepers are woken by thread::stop,
+	// lock waiters see the process stop and the threads they wait for end on their own.
+	// create_thread checks the flag after publishing a thread, see there
+	stoppable_task::stop();
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
 	foreach_no_except(thread_table, [](auto thread) {
 		// According to specification:
 		// "If initial thread is ended, end whole program."
@@ -109,10 +290,45 @@ void process::terminate() noexcept
 			thread->evm2_thread->stop();
 	});
 
-	foreach_no_except(thread_table, [](auto thread) {
-		if (thread && thread->std_thread)
-			if (thread->std_thread->joinable())
-				thread->std_thread->join();
+	// task mode: a task ended the process, the workers are joined by start which releases the threads
+	if (task_scheduler)
+	{
+		try
+		{
+			task_scheduler->stop();
+		}
+		catch (...) {}
+		return;
+	}
+
+	release();
+}
+
+void process::release() noexcept
+{
+	// no timer callback may run into a released thread or the scheduler
+	try
+	{
+		if (timers)
+			timers->stop();
+	}
+	catch (...) {}
+
+	// the process is stopped, create_thread doesn't spawn any more once this has passed
+	{
+		std::lock_guard spawn_lock(spawn_mutex);
+	}
+
+	// a thread is taken out of its slot to be joined, a guest joinThread may be joining it
+	foreach_no_except(thread_table, [this](auto thread) {
+		std::shared_ptr<std::thread> std_thread;
+		if (thread)
+		{
+			std::lock_guard spawn_lock(spawn_mutex);
+			std_thread = std::move(thread->std_thread);
+		}
+		if (std_thread && std_thread->joinable())
+			std_thread->join();
 	});
 
 	foreach_no_except(thread_table, [](auto thread) {
@@ -120,24 +336,82 @@ void process::terminate() noexcept
 			thread->std_thread.reset();
 		if (thread && thread->evm2_thread)
 			thread->evm2_thread.reset();
+		if (thread && thread->host)
+			thread->host.reset();
 	});
 
+	if (file)
+		file->flush(); // halt: pending writes are written, a mapped file is synced
+	file.reset();
+
 	try
 	{
-		if (binary_file.is_open())
-			binary_file.close();
+		console.flush();
 	}
-	catch (...)	{}
+	catch (...) {}
 
 }
 
+// a joined thread's slot, its id, thread and machine are reused by the next create_thread
+void process::free_slot(uint64_t thread_id)
+{
+	const auto& thread = thread_table[thread_id]->evm2_thread;
+	if (thread_id == 0 || !thread || !thread->can_run())
+		return; // stopped threads are left alone, the process is ending
+
+	std::lock_guard lock_guard(free_slots_mutex);
+	free_slots.push_back(thread_id);
+}
+
+bool process::take_free_slot(uint64_t& thread_id)
+{
+	std::lock_guard lock_guard(free_slots_mutex);
+	if (free_slots.empty())
+		return false;
+	thread_id = free_slots.back();
+	free_slots.pop_back();
+	return true;
+}
+
 int64_t process::create_thread(const std::shared_ptr<thread>& current_thread, uint32_t entry_point)
 {
-	auto new_thread_no = static_cast<uint64_t>(thread_table.size());
-	const std::shared_ptr<thread_item> thread = std::make_shared<thread_item>();
-	thread->evm2_thread = thread::factory::create_thread(current_thread, entry_point);
-	thread->std_thread = nullptr;
-	thread_table.push_back(thread);
+	// release walks the table once the process is stopped - a thread is published and spawned
+	// before it starts to, or not at all. A reused slot may be one release has walked already
+	std::lock_guard spawn_lock(spawn_mutex);
+	if (!can_run())
+		return -1;
+
+	std::shared_ptr<thread_item> thread;
+	uint64_t new_thread_no;
+	if (take_free_slot(new_thread_no))
+	{
+		thread = thread_table[new_thread_no];
+		thread->evm2_thread->restart(current_thread, entry_point);
+		std::lock_guard lock_guard(thread->task_mutex);
+		thread->finished = false;
+		thread->joined = false;
+		thread->joiner = -1;
+	}
+	else
+	{
+		thread = std::make_shared<thread_item>();
+		thread->evm2_thread = thread::factory::create_thread(current_thread, entry_point);
+		thread->std_thread = nullptr;
+		new_thread_no = thread_table.push_back(thread);
+	}
+
+	// created while the process is being terminated - terminate may have missed it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!can_run())
+		thread->evm2_thread->stop();
+
+	if (task_scheduler)
+	{
+		if (!thread->host)
+			prepare_task(thread, new_thread_no);
+		task_scheduler->submit(new_thread_no);
+		return new_thread_no;
+	}
 
 	thread->std_thread = std::make_shared<std::thread>([this, new_thread_no]
 		{
@@ -153,110 +427,115 @@ void process::join_thread(uint64_t thread_to_join)
 		throw out_of_range_exception("Invalid join thread argument");
 
 	const auto thread = thread_table[thread_to_join];
-	
-	if (!thread || !thread->std_thread)
-		throw not_implemented_exception("Threads should be joined once");
-	
-	if (thread->std_thread->joinable())
+
+	// taken out of the slot, release or another joiner doesn't join it as well
+	std::shared_ptr<std::thread> std_thread;
+	if (thread)
 	{
-		thread->std_thread->join();
-		thread->std_thread.reset();
-	}	
-}
+		std::lock_guard spawn_lock(spawn_mutex);
+		std_thread = std::move(thread->std_thread);
+	}
 
-bool process::lock_exists(const uint64_t ix)
-{
-	return contains(lock_table, [ix](auto item) 
+	if (!std_thread)
 	{
-		return item && item->index == ix;
-	});
+		if (!can_run())
+			return; // release has taken it, the process is ending
+		throw not_implemented_exception("Threads should be joined once");
+	}
+
+	if (std_thread->joinable())
+		std_thread->join();
+	free_slot(thread_to_join);
 }
 
-bool process::lock_create(const uint64_t lock_ix, const uint64_t thread_ix)
+// the lock, if there is no queue; otherwise the waiters get it in their order
+bool process::try_lock(guest_lock& lock, const uint64_t thread_ix, int64_t& holder)
 {
-	// quick, unreliable check, because meanwhile other thread might create lock
-	if (lock_exists(lock_ix))
-		return false;
-
-	std::lock_guard lock_guard(lock_table_mutex);
-	if (lock_exists(lock_ix)) // reliable check
-		return false;
-
-	const auto new_lock = std::make_shared<lock_item>();
-	new_lock->index = lock_ix;
-	new_lock->thread_ix = thread_ix;
-	new_lock->mutex.lock();
-	lock_table.push_back(new_lock);
-		
-	return true;
+	holder = lock.owner;
+	return !lock.waiting && lock.try_acquire(thread_ix, holder);
 }
 
 void process::process_lock(const uint64_t lock_ix, const uint64_t thread_ix)
 {
-	if (lock_create(lock_ix, thread_ix))
-		return;	
+	auto& lock = locks.find(lock_ix);
+	int64_t holder;
+	if (try_lock(lock, thread_ix, holder))
+		return;
 	/*
 	 According to specification:
 	 "It is an undefined behavior to lock same lock multiple times within same thread
 	   locks are not guaranteed to be re-entrant"
 
-	   If you run script:
-	   .\reentrantlock.ps1
-	   you will get dead-lock after 1-5 seconds
-	   To fix this initialise is_re_entrant_lock = true;
+	 Locking an owned lock again is a no-op here (reentrantlock.ps1 used to dead-lock).
 	*/
-	
-	bool is_re_entrant_lock; // purposely skipping variable initialization
-	int64_t ix;
-	for (ix = 0; ix < lock_table.size(); ix++)
-		if (lock_table[ix] && lock_table[ix]->index == lock_ix)
-		{
-			if (lock_table[ix]->thread_ix == thread_ix)
-				break; // getting "undefined behavior" of isReEntrantLock
-			is_re_entrant_lock = false;
-			break;
-		}
+	if (holder == static_cast<int64_t>(thread_ix))
+		return;
 
-	if (is_re_entrant_lock) // re-entrant lock not guaranteed
+	// contended - queue up and park until the lock is handed over or the thread is stopped
+	const auto waiting_thread = thread_table[thread_ix]->evm2_thread;
+	waiting_thread->prepare_park();
+	if (enqueue(lock, thread_ix))
 		return;
+	waiting_thread->park();
 
-	const std::chrono::milliseconds nice_philosopher_wait_time(10);
-	while (can_run())
-		if (lock_table[ix]->mutex.try_lock_for(nice_philosopher_wait_time))
-		{
-			lock_table[ix]->thread_ix = thread_ix;
-			break;
-		}	
+	std::lock_guard lock_guard(lock.mutex);
+	if (lock.owner == static_cast<int64_t>(thread_ix))
+		return;
+	// stopped while waiting
+	const auto position = std::find(lock.parked.begin(), lock.parked.end(), thread_ix);
+	if (position != lock.parked.end())
+	{
+		lock.parked.erase(position);
+		lock.waiting--;
+	}
 }
 
-bool process::thread_holds_any_lock(const uint64_t thread_ix)
+// false if the task was parked
+bool process::lock_task(const uint64_t lock_ix, const uint64_t thread_ix)
 {
-	return contains(lock_table,[thread_ix](auto item) {
-		
-		return item && item->thread_ix == static_cast<int64_t>(thread_ix);
-		
-	});
+	auto& lock = locks.find(lock_ix);
+	int64_t holder;
+	if (try_lock(lock, thread_ix, holder) || holder == static_cast<int64_t>(thread_ix)) // see process_lock
+		return true;
+	return enqueue(lock, thread_ix);
 }
 
-void process::process_unlock(const uint64_t lock_ix, const uint64_t thread_ix)
+// queues the thread on the lock, true if the lock was free meanwhile and it has got it
+bool process::enqueue(guest_lock& lock, const uint64_t thread_ix)
 {
-	for (auto& lock : lock_table)
-		if (lock && lock->index == lock_ix)
-		{
-			if (lock->thread_ix >= 0)
-			{
-				lock->thread_ix = -1;
-				lock->mutex.unlock();
-			}						
-			break;
-		}
-
-	// forcing philosophers to "think" after eating and stop fighting each other
-	if (!thread_holds_any_lock(thread_ix))
+	std::lock_guard lock_guard(lock.mutex);
+	int64_t holder;
+	lock.waiting++;
+	if (lock.parked.empty() && lock.try_acquire(thread_ix, holder))
 	{
-		constexpr std::chrono::milliseconds philosophers_think_time(50);
-		std::this_thread::sleep_for(philosophers_think_time);
+		lock.waiting--;
+		return true;
 	}
+	lock.parked.push_back(thread_ix);
+	return false;
+}
+
+void process::process_unlock(const uint64_t lock_ix)
+{
+	auto& lock = locks.find(lock_ix);
+	lock.release();
+	if (!lock.waiting)
+		return;
+
+	// handed over directly, the first waiter resumes as the owner - unless a
+	// thread took the lock meanwhile, its unlock hands it over then
+	std::lock_guard lock_guard(lock.mutex);
+	int64_t holder;
+	if (lock.parked.empty() || !lock.try_acquire(lock.parked.front(), holder))
+		return;
+
+	const auto owner = lock.parked.front();
+	lock.parked.pop_front();
+	lock.waiting--;
+	if (task_scheduler)
+		task_scheduler->submit(owner);
+	else
+		thread_table[owner]->evm2_thread->unpark();
 }
 
 int64_t process::console_read()
@@ -270,72 +549,59 @@ int64_t process::console_read()
 		input->erase(input->begin());
 		return result;
 	}
+	console.flush(); // a prompt is shown before the program waits for input
 	std::cin >> std::hex >> result;
 	return result;
 }
 
 void process::console_write(uint64_t number) 
 {
-	std::lock_guard lock_guard(io_mutex);
-
 	if (output)
 	{
+		std::lock_guard lock_guard(io_mutex);
 		output->push_back(number);
 		return;
 	}
 
-	std::cout.width(16);
-	std::cout.fill('0');
-	std::right(std::cout);
-	std::cout << std::hex << number << std::endl;
+	console.write(number);
 }
 
 size_t process::file_read(size_t file_offset, size_t bytes_count, size_t memory_address)
 {
-	std::lock_guard lock_guard(binary_file_mutex);
-
-	if (bytes_count == 0 || !binary_file.is_open())
+	if (bytes_count == 0 || !file)
 		return 0;
 
-	binary_file.seekg(0, SEEK_END);
-	const size_t file_size = binary_file.tellg();
+	const auto file_size = file->size();
 	if (file_offset >= file_size)
 		return 0;
 
-	binary_file.seekg(file_offset, SEEK_SET);
-	if (file_offset + bytes_count > file_size)
-		bytes_count = file_size - file_offset - bytes_count; // fix bytes_count
-	binary_file.read(reinterpret_cast<char*>(memory.data()) + memory_address, bytes_count);
+	if (bytes_count > file_size - file_offset)
+		bytes_count = file_size - file_offset; // fix bytes_count
+	check_memory_range(memory, memory_address, bytes_count, "File read memory out of range");
 
-	return bytes_count; // original or fixed value
+	return file->read(file_offset, reinterpret_cast<uint8_t*>(memory.data()) + memory_address, bytes_count); // original or fixed value
 }
 
 void process::file_write(size_t file_offset, size_t bytes_to_write, size_t memoryAddress)
 {
-	std::lock_guard lock_guard(binary_file_mutex);
-
-	if (!binary_file.is_open())
+	if (!file)
 		return;
 
-	// grow file
-	binary_file.seekg(0, SEEK_END);
-	const size_t file_size = binary_file.tellg();
-	if (file_offset > file_size)
-	{
-		const size_t bytes_to_grow = file_offset - file_size;
-		bytes_buffer buffer(bytes_to_grow);
-		binary_file.write(reinterpret_cast<char*>(buffer.data()), bytes_to_grow);
-	}
-
-	// perform write
-	binary_file.seekg(file_offset, SEEK_SET);
-	binary_file.write(reinterpret_cast<char*>(memory.data()) + memoryAddress, bytes_to_write);
+	check_memory_range(memory, memoryAddress, bytes_to_write, "File write memory out of range");
+	if (bytes_to_write > UINT64_MAX - file_offset || file_offset + bytes_to_write > INT64_MAX)
+		throw out_of_range_exception("File write offset out of range");
+	file->write(file_offset, reinterpret_cast<const uint8_t*>(memory.data()) + memoryAddress, bytes_to_write);
 }
 
-process::process(evm2_header& header, evm2_code& code, evm2_memory& data)
-	:header(header), code(code), memory(data) {}
+process::process(const evm2_header& header, evm2_code code, evm2_memory data)
+	:header(header), code(std::move(code)), memory(std::move(data)) {}
 
 std::shared_ptr<process> process::factory::create(const std::string& file_name)
+{
+	return create(file_name, false);
+}
+
+std::shared_ptr<process> process::factory::create(const std::string& file_name, bool use_image_cache)
 {
 	// base file check
 	if (!boost::filesystem::exists(file_name))
@@ -345,22 +611,23 @@ std::shared_ptr<process> process::factory::create(const std::string& file_name)
 	if (file_size < sizeof(evm2_header))
 		throw image_exception(boost::format("Invalid image %1% format - file is too short") % file_name);
 
-	// read file into a buffer
-	std::ifstream file;
-	file.open(file_name, std::ios::binary);
-	if (!file.is_open())
+	// map the image, header, code and initial data are read in place
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+	try
+	{
+		file = boost::interprocess::file_mapping(file_name.c_str(), boost::interprocess::read_only);
+		region = boost::interprocess::mapped_region(file, boost::interprocess::read_only);
+	}
+	catch (const boost::interprocess::interprocess_exception&)
+	{
 		throw image_exception(boost::format("Image %1% open error") % file_name);
-
-	file.unsetf(std::ios::skipws);
-	bytes_buffer buffer(file_size);
-	buffer.insert(buffer.begin(),
-		std::istream_iterator<uint8_t>(file),
-		std::istream_iterator<uint8_t>());
-	file.close();
+	}
+	const auto* image = static_cast<const uint8_t*>(region.get_address());
 
 	// examine header
 	evm2_header header = {};
-	std::copy_n(buffer.begin(), sizeof header, reinterpret_cast<char*>(&header));
+	std::memcpy(&header, image, sizeof header);
 
 	const bool dataSizeIsValid = header.data_size >= header.initial_data_size;
 	if (!dataSizeIsValid)
@@ -369,27 +636,33 @@ std::shared_ptr<process> process::factory::create(const std::string& file_name)
 	if (std::strncmp(evm2_magic, header.magic, evm2_magic_size) != 0)
 		throw image_exception(boost::format("Invalid image %1% format - bad magic string") % file_name);
 		
-	const uint32_t expected_file_size =
-		header.code_size + header.initial_data_size + sizeof(header);
+	const uint64_t expected_file_size =
+		static_cast<uint64_t>(header.code_size) + header.initial_data_size + sizeof(header);
 	
 	if (file_size != expected_file_size)
 		throw image_exception(boost::format(
 			"Invalid image %1% - bad image size %2%, should be %3% ")
 			% file_name % file_size % expected_file_size);
 
-	// prepare evm code
-#pragma warning( disable : 4244 ) 
-	for (auto i = sizeof header; i < sizeof header + header.code_size; i++)
-		buffer[i] = (buffer[i] * 0x0202020202ULL & 0x010884422010ULL) % 1023;
-
-	boost::dynamic_bitset<uint8_t> code(8 * header.code_size);
-	from_block_range(buffer.begin() + sizeof header,
-		buffer.begin() + sizeof header + header.code_size, code);
+	// prepare evm code - from the image cache, or bits of the image bytes are reversed on the way
+	evm2_code code;
+	std::shared_ptr<code_verifier> verification;
+	const auto cache_name = image_cache::file_name_for(file_name);
+	const auto hash = use_image_cache ? image_cache::image_hash(image, file_size) : 0;
+	if (!use_image_cache || !image_cache::load(cache_name, hash, code, verification))
+	{
+		code = evm2_code::from_image(image + sizeof header, header.code_size);
+		verification = code_verifier::factory::create(code);
+		if (use_image_cache)
+			image_cache::save(cache_name, hash, code, *verification);
+	}
 
 	// prepare evm data 
 	evm2_memory data(header.data_size);
-	std::copy_n(buffer.begin() + sizeof(header) + header.code_size,
-		header.initial_data_size, data.begin());
+	std::copy_n(image + sizeof header + header.code_size, header.initial_data_size, data.begin());
 
-	return std::make_shared<process>(header, code, data);
+	auto result = std::make_shared<process>(header, std::move(code), std::move(data));
+	result->verification = std::move(verification);
+	result->decoded_code = program::factory::create(result->code, result->verification);
+	return result;
 }
@@ -3,11 +3,14 @@
 #include <memory>
 #include <string>
 #include <vector>
-#include <boost/dynamic_bitset/dynamic_bitset.hpp>
-#include <concurrent_vector.h>
 #include <fstream>
 #include <thread>
 #include <thread>
+#include "binary_file.h"
+#include "console_output.h"
+#include "lock_registry.h"
+#include "scheduler.h"
+#include "segmented_vector.h"
 #include "thread.h"
 #include "evm2_types.h"
 
@@ -15,45 +18,83 @@ struct thread_item
 {
 	std::shared_ptr<thread> evm2_thread;
 	std::shared_ptr<std::thread> std_thread;
+
+	// thread_model::tasks only
+	std::shared_ptr<machine_host> host;
+	std::mutex task_mutex;   // guards the fields below
+	bool finished = false;
+	bool joined = false;
+	int64_t joiner = -1;     // task parked in joinThread until this one ends
 };
 
-struct lock_item
+enum class thread_model
 {
-	uint64_t index = 0;
-	int64_t thread_ix = -1; // (-1) means free, un-locked mutex
-	std::timed_mutex mutex;
+	os_threads, // one std::thread per guest thread
+	tasks       // guest threads are tasks multiplexed over a pool of workers, see scheduler
 };
 
 class process : public stoppable_task
 {
-	std::mutex lock_table_mutex;
-	Concurrency::concurrent_vector<std::shared_ptr<lock_item>> lock_table;
+	lock_registry locks;
 	
-	Concurrency::concurrent_vector<std::shared_ptr<thread_item>> thread_table;
+	segmented_vector<std::shared_ptr<thread_item>> thread_table;
+	std::mutex spawn_mutex;            // std_thread of the slots, create_thread and joins against release
+	std::mutex free_slots_mutex;
+	std::vector<uint64_t> free_slots;  // ids of joined threads, see free_slot
+	void free_slot(uint64_t);
+	bool take_free_slot(uint64_t&);
 
 	std::mutex io_mutex;
+	console_output console{ std::cout }; // not used with an output vector
 	int64_t console_read();
 	void console_write(uint64_t);
 	
-	std::fstream binary_file;
-	std::mutex binary_file_mutex;
+	std::shared_ptr<binary_file> file;  // positional, transfers of threads only serialize on overlapping ranges
 	size_t file_read(size_t, size_t, size_t);
 	void file_write(size_t, size_t, size_t);
 
 	int64_t create_thread(const std::shared_ptr<thread>&, uint32_t);	
 	void join_thread(uint64_t);
 
-	bool lock_exists(uint64_t ix);
-	bool lock_create(uint64_t, uint64_t);
+	bool try_lock(guest_lock&, uint64_t, int64_t&);
+	bool enqueue(guest_lock&, uint64_t);
 	void process_lock(uint64_t, uint64_t);	
-	bool thread_holds_any_lock(uint64_t);
-	void process_unlock(uint64_t, uint64_t);
+	void process_unlock(uint64_t);
+
+	std::shared_ptr<jit_compiler> jit; // shared by all threads, dispatch_engine::jit only
+
+	// thread_model::tasks
+	bool lock_task(uint64_t, uint64_t);
+
+	std::shared_ptr<scheduler> task_scheduler;
+	std::mutex task_failure_mutex;
+	std::exception_ptr task_failure; // first exception of a task, rethrown by start
+	void prepare_task(const std::shared_ptr<thread_item>&, uint64_t);
+	void run_task(uint64_t);
+	void end_task(uint64_t);
+	bool join_task(uint64_t, uint64_t);
 
+	std::shared_ptr<timer_queue> timers; // sleep deadlines of all threads
+	void attach(thread&, machine_host&);
 	void run(uint64_t);
+	bool execute(const std::shared_ptr<thread>&, uint64_t, evm2_op_code);
+
+	// lets the threaded engine of a thread execute process instructions in place
+	struct thread_host : machine_host
+	{
+		process& owner;
+		std::shared_ptr<thread> evm2_thread;
+		uint64_t thread_id;
+		std::exception_ptr failure; // rethrown by process::run, as if the switch engine returned
+
+		thread_host(process&, std::shared_ptr<thread>, uint64_t);
+		bool execute(machine&, evm2_op_code) override;
+	};
 
 	void hlt(uint64_t);
 
 	void terminate() noexcept;
+	void release() noexcept;
 
 public:
 	evm2_header header;	
@@ -61,6 +102,14 @@ public:
 	evm2_memory memory;
 
 	std::string binary_file_name;
+	bool interactive_console = false; // console output is written after every value instead of in batches
+	bool map_binary_file = false; // guest read/write copy from and to a mapping of the file, see binary_file
+	dispatch_engine engine = dispatch_engine::switch_loop;
+	thread_model threads = thread_model::os_threads;
+	unsigned workers = 0; // thread_model::tasks only, 0 = one per hardware thread
+	std::shared_ptr<aot_module> native; // evm2c translation of the image, runs on the threaded engine
+	std::shared_ptr<const code_verifier> verification; // facts about the reachable code, see code_verifier
+	std::shared_ptr<const program> decoded_code;       // shared by all threads
 	
 	evm2_io_stream input;
 	evm2_io_stream output;
@@ -68,10 +117,12 @@ public:
 	void start();
 	void stop();
 	
-	process(evm2_header&, evm2_code&, evm2_memory&);
+	process(const evm2_header&, evm2_code, evm2_memory);
 
 	struct factory
 	{
 		static std::shared_ptr<process> create(const std::string&);
+		// use_image_cache: load from / save to the .evmc cache next to the image, see image_cache
+		static std::shared_ptr<process> create(const std::string&, bool use_image_cache);
 	};
 };
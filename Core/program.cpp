@@ -0,0 +1,102 @@
+#include "pch.h"
+
+void program::decode_block(uint32_t address) const
+{
+	std::vector<verified_instruction> block;
+	while (address < code.size() && !index[address].load(std::memory_order_relaxed))
+	{
+		code_decoder.jump(address);
+		const auto op_code = code_decoder.fetch();
+		block.push_back({ code_decoder.instruction, address, 0 });
+
+		address = code_decoder.get_address();
+		if (ends_block(op_code))
+			break;
+	}
+
+	install_block(block.data(), block.size(), address);
+}
+
+// caches count decoded instructions as one block, followed by a block_link to next
+void program::install_block(const verified_instruction* instructions, size_t count, uint32_t next) const
+{
+	auto cached = std::make_unique<cached_instruction[]>(count + 1);
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto verified = verification && verification->target_verified(instructions[i].address);
+		cached[i].instruction = instructions[i].instruction;
+		cached[i].address = instructions[i].address;
+		cached[i].handler = threaded_engine::handler_for(instructions[i].instruction, verified);
+		cached[i].target_verified = verified;
+	}
+	cached[count].instruction.op_code = block_link;
+	cached[count].address = next;
+	cached[count].handler = threaded_engine::handler_for(cached[count].instruction, false);
+	if (fused)
+		threaded_engine::fuse(cached.get(), count + 1);
+
+	for (size_t i = 0; i < count; i++)
+		index[cached[i].address].store(&cached[i], std::memory_order_release);
+	blocks.push_back(std::move(cached));
+}
+
+const cached_instruction& program::decode_late(uint32_t address) const
+{
+	std::lock_guard lock_guard(decode_mutex);
+	if (!index[address].load(std::memory_order_relaxed))
+		decode_block(address);
+	return *index[address].load(std::memory_order_relaxed);
+}
+
+bool program::ends_block(evm2_op_code op_code)
+{
+	switch (op_code)
+	{
+		case jump_address:
+		case jump_equal:
+		case call:
+		case ret:
+		case halt:
+		case padding:
+		case ukn01011:
+		case ukn01111:
+		case ukn010000:
+			return true;
+		default:
+			return false;
+	}
+}
+
+program::program(evm2_code& code, std::shared_ptr<const code_verifier> verification, bool fused)
+	: code(code), verification(std::move(verification)), code_decoder(code, evm_default_entry_point),
+	index(std::make_unique<std::atomic<const cached_instruction*>[]>(code.size())), fused(fused)
+{
+	end_of_code.address = static_cast<uint32_t>(code.size());
+	end_of_code.handler = threaded_engine::handler_for(end_of_code.instruction, false);
+
+	// everything reachable, straight from the instructions the verifier decoded (or an image cache holds) -
+	// a block ends at a block boundary found by the verifier, at a transfer or where the next one isn't recorded
+	if (!this->verification)
+		return;
+	const auto& reachable = this->verification->reachable_code();
+	for (size_t first = 0, i = 0; i < reachable.size(); i++)
+	{
+		const auto next = reachable[i].address + reachable[i].instruction.length;
+		if (i + 1 == reachable.size() || ends_block(reachable[i].instruction.op_code) ||
+			reachable[i + 1].address != next || (reachable[i + 1].flags & verified_instruction::block_start))
+		{
+			install_block(&reachable[first], i + 1 - first, next);
+			first = i + 1;
+		}
+	}
+}
+
+std::shared_ptr<const program> program::factory::create(evm2_code& code, std::shared_ptr<const code_verifier> verification)
+{
+	return create(code, std::move(verification), true);
+}
+
+std::shared_ptr<const program> program::factory::create(evm2_code& code, std::shared_ptr<const code_verifier> verification, bool fused)
+{
+	return std::make_shared<const program>(code, std::move(verification), fused);
+}
\ No newline at end of file
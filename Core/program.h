@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "code_verifier.h"
+#include "decoder.h"
+#include "evm2_types.h"
+#include "evm2_op_code.h"
+
+class machine;
+struct cached_instruction;
+
+// threaded engine handler, returns instruction to continue with (nullptr leaves the engine)
+using instruction_handler = const cached_instruction* (*)(machine&, const cached_instruction&);
+
+// jit translated block, gets the register file and returns the bit address to continue with
+using native_block = uint32_t (*)(int64_t*);
+
+struct cached_instruction
+{
+	evm2_instruction instruction;
+	uint32_t address = 0;                          // bit address of the instruction
+	instruction_handler handler = nullptr;
+	bool target_verified = false;                  // jump/jumpEqual/call target proven inside the code
+	mutable std::atomic<uint32_t> executions{ 0 }; // block entry counter of the jit, approximate
+	mutable std::atomic<native_block> native{ nullptr }; // jit translation of the block starting here
+};
+
+// Decoded form of the program code, created once per process and shared by
+// all its threads - a thread only keeps its instruction pointer.
+// The code reachable according to the verifier is cached up front, in basic
+// blocks, from the instructions the verifier decoded - it isn't decoded again.
+// Every block is one array terminated by a block_link pseudo-instruction,
+// so the instruction following a decoded one is always its next array element.
+// An address the verifier didn't see is decoded on first use under a lock.
+class program
+{
+	evm2_code& code;
+	std::shared_ptr<const code_verifier> verification;        // facts proven at load time, may be null
+
+	mutable std::mutex decode_mutex;                          // guards late decoding
+	mutable decoder code_decoder;
+	std::unique_ptr<std::atomic<const cached_instruction*>[]> index; // bit address -> decoded instruction
+	mutable std::vector<std::unique_ptr<cached_instruction[]>> blocks; // decoded blocks, stable addresses
+	cached_instruction end_of_code;                           // returned for addresses past the code end
+	const bool fused;                                         // superinstructions, see threaded_engine::fuse
+
+	void decode_block(uint32_t) const;
+	void install_block(const verified_instruction*, size_t, uint32_t) const;
+	const cached_instruction& decode_late(uint32_t) const;
+	static bool ends_block(evm2_op_code);
+
+public:
+	program(evm2_code&, std::shared_ptr<const code_verifier>, bool fused);
+
+	size_t size() const { return code.size(); }
+
+	const cached_instruction& at(uint32_t address) const
+	{
+		if (address >= code.size())
+			return end_of_code;
+		if (const auto* instruction = index[address].load(std::memory_order_acquire))
+			return *instruction;
+		return decode_late(address);
+	}
+
+	struct factory
+	{
+		static std::shared_ptr<const program> create(evm2_code&, std::shared_ptr<const code_verifier>);
+		// fused: false keeps one handler per instruction
+		static std::shared_ptr<const program> create(evm2_code&, std::shared_ptr<const code_verifier>, bool fused);
+	};
+};
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "pch.h"
+
+namespace
+{
+	// worker the calling thread is, tasks it submits go to its own queue
+	thread_local const scheduler* current_scheduler = nullptr;
+	thread_local size_t current_worker = 0;
+}
+
+scheduler::scheduler(task_step step, std::shared_ptr<timer_queue> timers, unsigned worker_count)
+	: step(std::move(step)), timers(std::move(timers))
+{
+	if (!worker_count)
+		worker_count = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned i = 0; i < worker_count; i++)
+		queues.push_back(std::make_unique<worker_queue>());
+}
+
+scheduler::~scheduler()
+{
+	stop();
+	for (auto& worker : workers)
+		if (worker.joinable())
+			worker.join();
+}
+
+void scheduler::run(uint64_t first)
+{
+	submit(first);
+	for (size_t i = 0; i < queues.size(); i++)
+		workers.emplace_back([this, i] { work(i); });
+
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void scheduler::stop()
+{
+	stopping = true;
+	std::lock_guard lock_guard(idle_mutex);
+	idle.notify_all();
+}
+
+void scheduler::submit(uint64_t task)
+{
+	push(task, false);
+}
+
+void scheduler::yield(uint64_t task)
+{
+	push(task, true);
+}
+
+void scheduler::push(uint64_t task, bool behind)
+{
+	const auto index = current_scheduler == this ? current_worker : next_queue++ % queues.size();
+	{
+		std::lock_guard lock_guard(queues[index]->mutex);
+		if (behind)
+			queues[index]->tasks.push_front(task);
+		else
+			queues[index]->tasks.push_back(task);
+	}
+	queued++;
+	wake();
+}
+
+void scheduler::submit_at(uint64_t task, clock::time_point deadline)
+{
+	timers->add(deadline, [this, task] { submit(task); });
+}
+
+void scheduler::wake()
+{
+	if (!sleeping)
+		return;
+	std::lock_guard lock_guard(idle_mutex);
+	idle.notify_one();
+}
+
+bool scheduler::take(size_t worker, uint64_t& task)
+{
+	// own queue first, newest task - its machine state is likely still in the cache
+	{
+		auto& own = *queues[worker];
+		std::lock_guard lock_guard(own.mutex);
+		if (!own.tasks.empty())
+		{
+			if (++own.takes % fair_interval)
+			{
+				task = own.tasks.back();
+				own.tasks.pop_back();
+			}
+			else
+			{
+				task = own.tasks.front();
+				own.tasks.pop_front();
+			}
+			queued--;
+			return true;
+		}
+	}
+
+	// steal the oldest task of another worker
+	for (size_t i = 1; i < queues.size(); i++)
+	{
+		auto& victim = *queues[(worker + i) % queues.size()];
+		std::lock_guard lock_guard(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void scheduler::work(size_t worker)
+{
+	current_scheduler = this;
+	current_worker = worker;
+
+	while (!stopping)
+	{
+		uint64_t task;
+		if (take(worker, task))
+		{
+			step(task);
+			continue;
+		}
+
+		// nothing to run - wait for a submit, a sleeping task comes back through the timer queue
+		std::unique_lock lock(idle_mutex);
+		sleeping++;
+		if (!stopping && !queued)
+			idle.wait(lock);
+		sleeping--;
+	}
+	current_scheduler = nullptr;
+}
+
+std::shared_ptr<scheduler> scheduler::factory::create(task_step step, std::shared_ptr<timer_queue> timers, unsigned worker_count)
+{
+	return std::make_shared<scheduler>(std::move(step), std::move(timers), worker_count);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "timer_queue.h"
+
+// M:N scheduling of guest threads - every guest thread is a task identified by
+// its thread id, the tasks run on a fixed pool of workers.
+// A worker takes tasks from the back of its own queue and, when that runs dry,
+// steals from the front of the others' queues. Every fair_interval-th task of
+// its own queue is taken from the front, so a chain of newer tasks can't starve
+// the older ones - tasks woken by timers or yielded ones.
+// A task which would block (sleep, join, contended lock) isn't queued again by
+// its step, it is parked - whoever ends the wait submits it, so a waiting guest
+// thread doesn't hold a worker.
+class scheduler
+{
+public:
+	using clock = timer_queue::clock;
+
+	// runs one step of a task; the step submits the task again unless it parked or ended
+	using task_step = std::function<void(uint64_t)>;
+
+	// stop request checks a task runs before it yields its worker, see machine::time_slice
+	static constexpr uint32_t time_slice = 64;
+
+	static constexpr uint32_t fair_interval = 32;
+
+private:
+	struct worker_queue
+	{
+		std::mutex mutex;
+		std::deque<uint64_t> tasks;
+		uint32_t takes = 0;  // by the owner, see fair_interval
+	};
+
+	task_step step;
+	std::shared_ptr<timer_queue> timers;       // sleeping tasks are submitted from the timer thread
+	std::vector<std::unique_ptr<worker_queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> next_queue{ 0 };       // round robin for tasks submitted from outside the pool
+
+	std::mutex idle_mutex;
+	std::condition_variable idle;
+	std::atomic<size_t> queued{ 0 };           // tasks in all queues
+	std::atomic<size_t> sleeping{ 0 };         // workers waiting on idle
+	std::atomic<bool> stopping{ false };
+
+	void push(uint64_t, bool);
+	void work(size_t);
+	bool take(size_t, uint64_t&);
+	void wake();
+
+public:
+	scheduler(task_step, std::shared_ptr<timer_queue>, unsigned worker_count = 0);
+	~scheduler();
+	scheduler(const scheduler&) = delete;
+	scheduler& operator=(const scheduler&) = delete;
+
+	// starts the workers with the first task and returns when the scheduler is stopped
+	void run(uint64_t);
+	void stop();
+
+	void submit(uint64_t);
+	void yield(uint64_t); // queued behind the other tasks of the worker
+	void submit_at(uint64_t, clock::time_point);
+
+	struct factory
+	{
+		static std::shared_ptr<scheduler> create(task_step, std::shared_ptr<timer_queue>, unsigned worker_count = 0);
+	};
+};
\ No newline at end of file
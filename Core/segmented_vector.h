@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+// Append-only vector whose elements never move. It grows by segments of
+// doubling size, so indexing takes no lock while another thread appends.
+// Segment k holds indexes [first_size * (2^k - 1), first_size * (2^(k+1) - 1)).
+template<typename T>
+class segmented_vector
+{
+	static constexpr size_t first_size = 64;
+	static constexpr size_t segments = 48;
+
+	std::unique_ptr<T[]> storage[segments];
+	std::atomic<T*> segment[segments] = {};
+	std::atomic<size_t> count{ 0 };
+	std::mutex append_mutex;
+
+	static size_t segment_of(size_t index, size_t& offset)
+	{
+		const auto blocks = index / first_size + 1;
+		size_t k = 0;
+		while (blocks >> (k + 1))
+			k++;
+		offset = index - first_size * ((size_t(1) << k) - 1);
+		return k;
+	}
+
+public:
+	class iterator
+	{
+		segmented_vector* items;
+		size_t index;
+
+	public:
+		iterator(segmented_vector* items, size_t index) : items(items), index(index) {}
+		T& operator*() const { return (*items)[index]; }
+		iterator& operator++() { index++; return *this; }
+		bool operator!=(const iterator& other) const { return index != other.index; }
+	};
+
+	segmented_vector() = default;
+	segmented_vector(const segmented_vector&) = delete;
+	segmented_vector& operator=(const segmented_vector&) = delete;
+
+	size_t size() const { return count.load(std::memory_order_acquire); }
+
+	// valid for indexes below a size() seen before
+	T& operator[](size_t index)
+	{
+		size_t offset;
+		const auto k = segment_of(index, offset);
+		return segment[k].load(std::memory_order_acquire)[offset];
+	}
+
+	// returns the index of the new element
+	size_t push_back(const T& item)
+	{
+		std::lock_guard lock_guard(append_mutex);
+		const auto index = count.load(std::memory_order_relaxed);
+		size_t offset;
+		const auto k = segment_of(index, offset);
+		if (!storage[k])
+		{
+			storage[k] = std::make_unique<T[]>(first_size << k);
+			segment[k].store(storage[k].get(), std::memory_order_release);
+		}
+		storage[k][offset] = item;
+		count.store(index + 1, std::memory_order_release);
+		return index;
+	}
+
+	// the elements there are when iteration starts
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, size()); }
+};
\ No newline at end of file
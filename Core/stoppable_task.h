@@ -1,13 +1,13 @@
 #pragma once
-#include <future>
+#include <atomic>
 
+// Stop request of a process, thread or machine.
+// A relaxed flag - checked in the interpreter loops, it has to cost next to
+// nothing; nothing else is published through it.
 class stoppable_task
 {
-    bool can_run_cache;
-	std::promise<void> exit_signal;
-    std::future<void> future_obj;
+	std::atomic<bool> stop_requested{ false };
 public:
-    stoppable_task();
-    void stop();
-    bool can_run();
-};
+	void stop() { stop_requested.store(true, std::memory_order_relaxed); }
+	bool can_run() const { return !stop_requested.load(std::memory_order_relaxed); }
+};
\ No newline at end of file
@@ -8,8 +8,10 @@ evm2_op_code thread::run()
 		{
 			switch (const auto op_code = machine->Run()) {
 
-				case sleep: 
-					thread_sleep(machine->arg1);
+				case thread_sleep: 
+					if (cooperative)
+						return op_code;
+					sleep(machine->arg<0>());
 					break;
 
 				case ukn010000:
@@ -30,40 +32,75 @@ evm2_op_code thread::run()
 	}
 	catch (exception& ex)
 	{
-		std::cout << ex.message << std::endl;
-		std::cout << "Thread has been stopped" << std::endl;
+		report(ex.message + "\nThread has been stopped");
 		return stopped;
 	}
 	catch (std::exception& ex)
 	{
-		std::cout << ex.what() << std::endl;
-		std::cout << "Thread has been stopped" << std::endl;
+		report(std::string(ex.what()) + "\nThread has been stopped");
 		return stopped;
 	}	
 	catch (...)
 	{
-		std::cout << "Thread has been stopped";
+		report("Thread has been stopped");
 		return stopped;
 	}	
 }
 
-void thread::thread_sleep(int64_t milliseconds)
+void thread::report(const std::string& text)
 {
-	auto sleep_units = milliseconds / 100;
-	const auto rest_of_time = milliseconds % 100;
-	const std::chrono::milliseconds a_rest_of_div(rest_of_time);
-	constexpr std::chrono::milliseconds a100_ms(100);
-
-	if (sleep_units)
-		while (can_run() && sleep_units--)
-			std::this_thread::sleep_for(a100_ms);
-	if (rest_of_time)
-		std::this_thread::sleep_for(a_rest_of_div);
+	if (console)
+		console->message(text);
+	else
+		std::cout << text << std::endl;
 }
 
-thread::thread(evm2_code& code, evm2_memory& data)
+void thread::stop()
 {
-	machine = machine::factory::create(code, data);
+	stoppable_task::stop();
+	machine->stop();
+	unpark();
+}
+
+void thread::prepare_park()
+{
+	std::lock_guard lock_guard(park_mutex);
+	unparked = false;
+}
+
+void thread::park()
+{
+	std::unique_lock lock(park_mutex);
+	park_signal.wait(lock, [this] { return unparked || !can_run(); });
+}
+
+void thread::unpark()
+{
+	std::lock_guard lock_guard(park_mutex);
+	unparked = true;
+	park_signal.notify_one();
+}
+
+void thread::sleep(int64_t milliseconds)
+{
+	const auto deadline = timer_queue::deadline_after(milliseconds);
+	prepare_park();
+
+	// the timer is added outside park_mutex, its callback takes that lock under the queue lock
+	if (!timers)
+	{
+		std::unique_lock lock(park_mutex);
+		park_signal.wait_until(lock, deadline, [this] { return unparked || !can_run(); });
+		return;
+	}
+	const auto timer = timers->add(deadline, [this] { unpark(); });
+	park();
+	timers->cancel(timer);
+}
+
+thread::thread(std::shared_ptr<const program> code, evm2_memory& data)
+{
+	machine = machine::factory::create(std::move(code), data);
 }
 
 thread::thread(const std::shared_ptr<thread>& parent, uint32_t entry_point)
@@ -71,9 +108,14 @@ thread::thread(const std::shared_ptr<thread>& parent, uint32_t entry_point)
 	machine = machine::factory::duplicate(parent->machine, entry_point);
 }
 
-std::shared_ptr<thread> thread::factory::create_main_thread(evm2_code& code, evm2_memory& data)
+void thread::restart(const std::shared_ptr<thread>& parent, uint32_t entry_point)
+{
+	machine->restart(*parent->machine, entry_point);
+}
+
+std::shared_ptr<thread> thread::factory::create_main_thread(std::shared_ptr<const program> code, evm2_memory& data)
 {
-	return std::make_shared<thread>(code, data);
+	return std::make_shared<thread>(std::move(code), data);
 }
 
 std::shared_ptr<thread> thread::factory::create_thread(const std::shared_ptr<thread>& parent, uint32_t entry_point)
@@ -1,23 +1,42 @@
 #pragma once
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include "console_output.h"
 #include "machine.h"
 #include "evm2_types.h"
 #include "stoppable_task.h"
+#include "timer_queue.h"
 
 class thread : public stoppable_task
 {
-	std::shared_ptr<machine> machine;
-	void thread_sleep(int64_t);
+	std::shared_ptr<::machine> machine;
+
+	// sleep and lock waits park the thread until a timer or an unlock unparks it, or the thread is stopped
+	std::mutex park_mutex;
+	std::condition_variable park_signal;
+	bool unparked = false;
+	void prepare_park();  // before the thread is made visible to its waker
+	void park();
+	void unpark();
+	void sleep(int64_t);
+	void report(const std::string&);
 	friend class process;
 
 public:
+	std::shared_ptr<timer_queue> timers; // sleep deadlines, a private wait_until if null
+	console_output* console = nullptr;   // fault messages go after the output written so far, std::cout if null
+	bool cooperative = false; // task mode: sleep is returned to the caller, which parks the task instead of blocking
+
 	evm2_op_code run();
-	thread(evm2_code&, evm2_memory&);
+	void stop();
+	void restart(const std::shared_ptr<thread>&, uint32_t); // a joined thread runs again, as if created
+	thread(std::shared_ptr<const program>, evm2_memory&);
 	thread(const std::shared_ptr<thread>&, uint32_t);
 
 	struct factory
 	{
-		static std::shared_ptr<thread> create_main_thread(evm2_code&, evm2_memory&);
+		static std::shared_ptr<thread> create_main_thread(std::shared_ptr<const program>, evm2_memory&);
 		static std::shared_ptr<thread> create_thread(const std::shared_ptr<thread>&, uint32_t);
 	};
 };
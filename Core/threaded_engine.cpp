@@ -0,0 +1,285 @@
+#include "pch.h"
+
+// handlers are friends of the machine
+struct threaded_handlers
+{
+	// leaves the engine, machine::Run returns op_code
+	static const cached_instruction* leave(machine& machine, const cached_instruction& instruction, evm2_op_code op_code)
+	{
+		machine.current = &instruction.instruction;
+		machine.instruction_pointer = instruction.address + instruction.instruction.length;
+		machine.exit_op_code = op_code;
+		return nullptr;
+	}
+
+	// control transfer - where the stop request and the time slice are checked (native module
+	// functions check them at their backward jumps) and where jit translated blocks and native
+	// module functions are entered
+	static const cached_instruction* transfer(machine& machine, uint32_t address)
+	{
+		auto enter_native = true; // false once a native function left, the instruction it left at is interpreted
+		for (;;)
+		{
+			machine.instruction_pointer = address;
+			if (!machine.checkpoint())
+				return nullptr;
+
+			if (enter_native && machine.native)
+				if (const auto function = machine.native->find(address))
+				{
+					if (!aot_module::run(machine, function, address))
+					{
+						machine.instruction_pointer = address;
+						return nullptr;
+					}
+					enter_native = false;
+					continue;
+				}
+
+			const auto* instruction = &machine.code->at(address);
+			if (!machine.jit || !machine.jit->hot(*instruction))
+				return instruction;
+
+			address = instruction->native.load(std::memory_order_acquire)(machine.registers.data());
+		}
+	}
+
+	static const cached_instruction* load_const(machine& machine, const cached_instruction& instruction)
+	{
+		machine.write(instruction.instruction.arguments[0], instruction.instruction.constant);
+		return &instruction + 1;
+	}
+
+	static const cached_instruction* mov(machine& machine, const cached_instruction& instruction)
+	{
+		const auto* arguments = instruction.instruction.arguments;
+		machine.write(arguments[1], machine.read(arguments[0]));
+		return &instruction + 1;
+	}
+
+	template<typename operation>
+	static const cached_instruction* binary(machine& machine, const cached_instruction& instruction)
+	{
+		machine.binary(instruction.instruction, operation());
+		return &instruction + 1;
+	}
+
+	// verified: the target is known to be inside the code, the range check is dropped
+	template<bool verified>
+	static const cached_instruction* jump(machine& machine, const cached_instruction& instruction)
+	{
+		if constexpr (!verified)
+			machine.jump(instruction.instruction.address);
+		return transfer(machine, instruction.instruction.address);
+	}
+
+	template<bool verified>
+	static const cached_instruction* jump_equal(machine& machine, const cached_instruction& instruction)
+	{
+		const auto* arguments = instruction.instruction.arguments;
+		if (machine.read(arguments[0]) == machine.read(arguments[1]))
+			return jump<verified>(machine, instruction);
+		return &instruction + 1;
+	}
+
+	template<bool verified>
+	static const cached_instruction* call(machine& machine, const cached_instruction& instruction)
+	{
+		machine.stack[--machine.stack_position] = instruction.address + instruction.instruction.length;
+		if (machine.stack_position == 0)
+			throw out_of_range_exception("Stack overflow");
+		return jump<verified>(machine, instruction);
+	}
+
+	static const cached_instruction* ret(machine& machine, const cached_instruction&)
+	{
+		const auto address = machine.stack[machine.stack_position++];
+		machine.jump(address);
+		return transfer(machine, address);
+	}
+
+	static const cached_instruction* block_link(machine& machine, const cached_instruction& instruction)
+	{
+		return transfer(machine, instruction.address);
+	}
+
+	// I/O, thread, lock and sleep instructions
+	static const cached_instruction* host(machine& machine, const cached_instruction& instruction)
+	{
+		const auto op_code = instruction.instruction.op_code;
+		leave(machine, instruction, op_code);
+		if (machine.host && machine.host->execute(machine, op_code))
+		{
+			// the host stops the machine on a fault, nothing after the instruction may run
+			if (!machine.can_run())
+			{
+				machine.exit_op_code = stopped;
+				return nullptr;
+			}
+			return &instruction + 1;
+		}
+		return nullptr;
+	}
+
+	// halt, padding and unknown instructions are returned to the caller
+	static const cached_instruction* exit(machine& machine, const cached_instruction& instruction)
+	{
+		return leave(machine, instruction, instruction.instruction.op_code);
+	}
+
+	// superinstruction - runs the handlers of consecutive instructions without
+	// returning to the dispatch loop, all but the last one continue with the next
+	template<instruction_handler first, instruction_handler... rest>
+	static const cached_instruction* fused(machine& machine, const cached_instruction& instruction)
+	{
+		if constexpr (sizeof...(rest) == 0)
+			return first(machine, instruction);
+		else
+		{
+			first(machine, instruction);
+			return fused<rest...>(machine, *(&instruction + 1));
+		}
+	}
+};
+
+namespace
+{
+	constexpr size_t max_fused = 4;
+
+	struct fusion
+	{
+		instruction_handler sequence[max_fused];
+		size_t length;
+		instruction_handler fused;
+	};
+
+	template<instruction_handler... handlers>
+	fusion fuse()
+	{
+		return { { handlers... }, sizeof...(handlers), threaded_handlers::fused<handlers...> };
+	}
+
+	template<instruction_handler... handlers>
+	struct handler_list {};
+
+	// handlers that always continue with the next instruction
+	using straight_line = handler_list<
+		threaded_handlers::load_const,
+		threaded_handlers::mov,
+		threaded_handlers::binary<std::plus<int64_t>>,
+		threaded_handlers::binary<std::minus<int64_t>>,
+		threaded_handlers::binary<std::divides<int64_t>>,
+		threaded_handlers::binary<std::modulus<int64_t>>,
+		threaded_handlers::binary<std::multiplies<int64_t>>,
+		threaded_handlers::binary<compare_operation>>;
+
+	using control = handler_list<
+		threaded_handlers::jump<true>, threaded_handlers::jump<false>,
+		threaded_handlers::jump_equal<true>, threaded_handlers::jump_equal<false>,
+		threaded_handlers::call<true>, threaded_handlers::call<false>,
+		threaded_handlers::ret>;
+
+	template<instruction_handler first, instruction_handler... seconds>
+	void add_pairs(std::vector<fusion>& fusions, handler_list<seconds...>)
+	{
+		(fusions.push_back(fuse<first, seconds>()), ...);
+	}
+
+	template<instruction_handler... firsts, typename seconds>
+	void add_pairs(std::vector<fusion>& fusions, handler_list<firsts...>, seconds)
+	{
+		(add_pairs<firsts>(fusions, seconds()), ...);
+	}
+
+	// longest first, fusion is greedy
+	std::vector<fusion> make_fusions()
+	{
+		std::vector<fusion> fusions;
+
+		// idioms of the compiler output
+		// pushN helper: loadConst 8, r2; add r14, r2, r14; mov rN, qword[r14]; ret
+		fusions.push_back(fuse<threaded_handlers::load_const, threaded_handlers::binary<std::plus<int64_t>>,
+			threaded_handlers::mov, threaded_handlers::ret>());
+		// popN helper: loadConst 8, r2; mov qword[r14], rN; sub r14, r2, r14; ret
+		fusions.push_back(fuse<threaded_handlers::load_const, threaded_handlers::mov,
+			threaded_handlers::binary<std::minus<int64_t>>, threaded_handlers::ret>());
+
+		// any other pair ending with an instruction that may continue, e.g. compare + jumpEqual
+		add_pairs(fusions, straight_line(), straight_line());
+		add_pairs(fusions, straight_line(), control());
+		return fusions;
+	}
+
+	const std::vector<fusion> fusions = make_fusions();
+
+	bool matches(const fusion& candidate, const cached_instruction* instructions, size_t count)
+	{
+		if (candidate.length > count)
+			return false;
+		for (size_t i = 0; i < candidate.length; i++)
+			if (instructions[i].handler != candidate.sequence[i])
+				return false;
+		return true;
+	}
+}
+
+void threaded_engine::fuse(cached_instruction* block, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		for (const auto& candidate : fusions)
+			if (matches(candidate, block + i, count - i))
+			{
+				block[i].handler = candidate.fused;
+				i += candidate.length - 1;
+				break;
+			}
+}
+
+bool threaded_engine::is_fused(instruction_handler handler)
+{
+	return std::any_of(fusions.begin(), fusions.end(), [handler](const auto& candidate) { return candidate.fused == handler; });
+}
+
+instruction_handler threaded_engine::handler_for(const evm2_instruction& instruction, bool verified_target)
+{
+	switch (instruction.op_code)
+	{
+		case load_const:   return threaded_handlers::load_const;
+		case mov:          return threaded_handlers::mov;
+		case add:          return threaded_handlers::binary<std::plus<int64_t>>;
+		case sub:          return threaded_handlers::binary<std::minus<int64_t>>;
+		case divide:       return threaded_handlers::binary<std::divides<int64_t>>;
+		case mod:          return threaded_handlers::binary<std::modulus<int64_t>>;
+		case mul:          return threaded_handlers::binary<std::multiplies<int64_t>>;
+		case compare:      return threaded_handlers::binary<compare_operation>;
+		case jump_address: return verified_target ? threaded_handlers::jump<true> : threaded_handlers::jump<false>;
+		case jump_equal:   return verified_target ? threaded_handlers::jump_equal<true> : threaded_handlers::jump_equal<false>;
+		case call:         return verified_target ? threaded_handlers::call<true> : threaded_handlers::call<false>;
+		case ret:          return threaded_handlers::ret;
+		case block_link:   return threaded_handlers::block_link;
+
+		case bin_read:
+		case bin_write:
+		case con_read:
+		case con_write:
+		case thread_create:
+		case thread_join:
+		case thread_sleep:
+		case lock:
+		case unlock:
+			return threaded_handlers::host;
+
+		default:
+			return threaded_handlers::exit;
+	}
+}
+
+evm2_op_code threaded_engine::run(machine& machine)
+{
+	machine.slice_left = machine.time_slice;
+	machine.budget = 1;
+	const auto* instruction = threaded_handlers::transfer(machine, machine.instruction_pointer);
+	while (instruction)
+		instruction = instruction->handler(machine, *instruction);
+	return machine.exit_op_code;
+}
\ No newline at end of file
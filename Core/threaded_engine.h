@@ -0,0 +1,20 @@
+#pragma once
+#include "program.h"
+
+class machine;
+
+// Direct threaded interpreter.
+// Every cached instruction carries the address of its handler and each handler
+// returns the instruction to continue with, so there is no central switch.
+// I/O, thread, lock and sleep instructions are executed in place by machine::host.
+struct threaded_engine
+{
+	// verified_target: the jump/call target was proven to be inside the code, see code_verifier
+	static instruction_handler handler_for(const evm2_instruction&, bool verified_target);
+
+	// replaces the handler of the first instruction of known sequences by a
+	// superinstruction, the others keep theirs - they can still be jumped to
+	static void fuse(cached_instruction*, size_t);
+	static bool is_fused(instruction_handler);
+	static evm2_op_code run(machine&);
+};
\ No newline at end of file
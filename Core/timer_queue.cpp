@@ -0,0 +1,74 @@
+#include "pch.h"
+
+timer_queue::timer_queue()
+{
+	timer_thread = std::thread([this] { run(); });
+}
+
+timer_queue::~timer_queue()
+{
+	stop();
+}
+
+void timer_queue::stop()
+{
+	{
+		std::lock_guard lock_guard(mutex);
+		stopping = true;
+		timers.clear();
+	}
+	signal.notify_one();
+	if (timer_thread.joinable())
+		timer_thread.join();
+}
+
+timer_queue::clock::time_point timer_queue::deadline_after(int64_t milliseconds)
+{
+	return clock::now() + std::chrono::milliseconds(std::clamp<int64_t>(milliseconds, 0, INT32_MAX));
+}
+
+timer_queue::handle timer_queue::add(clock::time_point deadline, callback function)
+{
+	std::lock_guard lock_guard(mutex);
+	const handle key{ deadline, next_id++ };
+	const auto earliest = timers.empty() || key < timers.begin()->first;
+	timers.emplace(key, std::move(function));
+	if (earliest)
+		signal.notify_one();
+	return key;
+}
+
+void timer_queue::cancel(const handle& key)
+{
+	std::lock_guard lock_guard(mutex);
+	timers.erase(key);
+}
+
+void timer_queue::run()
+{
+	std::unique_lock lock(mutex);
+	while (!stopping)
+	{
+		if (timers.empty())
+		{
+			signal.wait(lock);
+			continue;
+		}
+
+		const auto first = timers.begin();
+		if (first->first.first > clock::now())
+		{
+			signal.wait_until(lock, first->first.first);
+			continue;
+		}
+
+		const auto function = std::move(first->second);
+		timers.erase(first);
+		function();
+	}
+}
+
+std::shared_ptr<timer_queue> timer_queue::factory::create()
+{
+	return std::make_shared<timer_queue>();
+}
\ No newline at end of file
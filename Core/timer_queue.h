@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Deadlines of sleeping guest threads and of pending file writes, one timer thread per process.
+// The thread waits for the earliest deadline only, so sleepers cost nothing
+// while idle. Callbacks run on the timer thread under the queue lock, once
+// cancel returns the callback has either run or never will.
+class timer_queue
+{
+public:
+	using clock = std::chrono::steady_clock;
+	using callback = std::function<void()>;
+	using handle = std::pair<clock::time_point, uint64_t>;
+
+private:
+	std::mutex mutex;
+	std::condition_variable signal;
+	std::map<handle, callback> timers; // ordered by deadline, then by insertion
+	uint64_t next_id = 0;
+	bool stopping = false;
+	std::thread timer_thread;
+
+	void run();
+
+public:
+	timer_queue();
+	~timer_queue();
+	timer_queue(const timer_queue&) = delete;
+	timer_queue& operator=(const timer_queue&) = delete;
+
+	// deadline of a guest sleep, negative times don't wait and very long ones are cut to ~24 days
+	static clock::time_point deadline_after(int64_t milliseconds);
+
+	handle add(clock::time_point, callback);
+	void cancel(const handle&);
+
+	// joins the timer thread, callbacks not run yet are dropped
+	void stop();
+
+	struct factory
+	{
+		static std::shared_ptr<timer_queue> create();
+	};
+};
\ No newline at end of file
@@ -2,10 +2,14 @@
 #define PCH_H
 
 #include <filesystem>
+#include <sstream>
 #include <boost/dynamic_bitset/dynamic_bitset.hpp>
 #include "CppUnitTest.h"
 
 #include "exception.h"
 #include "process.h"
+#include "aot_translator.h"
+#include "image_cache.h"
+#include "threaded_engine.h"
 
 #endif
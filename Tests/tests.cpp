@@ -56,9 +56,9 @@ namespace tests
 					return false;
 				}
 
-				file1.seekg(0, SEEK_END);
+				file1.seekg(0, std::ios::end);
 				const size_t file1Size = file1.tellg();
-				file2.seekg(0, SEEK_END);
+				file2.seekg(0, std::ios::end);
 				const size_t file2Size = file1.tellg();
 				if (file1Size != file2Size)
 				{
@@ -83,6 +83,35 @@ namespace tests
 				return false;
 			}
 		}
+
+		// translates the sample and builds it with the host compiler into module, false if there's no compiler
+		bool build_native_module(const std::string& name, std::string& module) const
+		{
+			const auto directory = std::filesystem::temp_directory_path();
+#ifdef _WIN32
+			if (std::system("where cl >nul 2>&1") != 0)
+				return false;
+			module = (directory / ("evm2_native_test_" + name + ".dll")).string();
+#else
+			if (std::system("c++ --version >/dev/null 2>&1") != 0)
+				return false;
+			module = (directory / ("evm2_native_test_" + name + ".so")).string();
+#endif
+			const auto source = (directory / ("evm2_native_test_" + name + ".cpp")).string();
+			{
+				auto process = process::factory::create(get_path(name));
+				std::ofstream translation(source);
+				aot_translator::factory::create(process->code)->translate(translation);
+			}
+#ifdef _WIN32
+			const auto command = "cl /nologo /O2 /LD \"" + source + "\" /Fo\"" + source + ".obj\" /Fe\"" + module + "\" >nul";
+#else
+			const auto command = "c++ -O2 -shared -fPIC \"" + source + "\" -o \"" + module + "\"";
+#endif
+			Assert::IsTrue(std::system(command.c_str()) == 0);
+			std::filesystem::remove(source);
+			return true;
+		}
 		
 		TEST_METHOD(create_process_from_file)
 		{
@@ -134,6 +163,91 @@ namespace tests
 			process.reset();
 		}
 
+		// Test if every sample passes the load time verification
+		TEST_METHOD(verify_samples)
+		{
+			for (const auto* name : { "math.evm", "Memory.evm", "crc.evm", "xor-with-stack-frame.evm", "lock.evm", "threadingBase.evm" })
+			{
+				auto process = process::factory::create(get_path(name));
+				Assert::IsTrue(process->verification->verified());
+				Assert::IsTrue(process->verification->is_reachable(0));
+				Assert::IsTrue(process->verification->reachable_instructions() > 0);
+				process.reset();
+			}
+		}
+
+		// Test if a process loaded from the .evmc cache matches the one that wrote it and runs crc.evm
+		TEST_METHOD(image_cache_round_trip)
+		{
+			const auto image = std::filesystem::temp_directory_path() / "evm2_image_cache_test.evm";
+			std::filesystem::copy_file(get_path("crc.evm"), image, std::filesystem::copy_options::overwrite_existing);
+			const auto cache = image_cache::file_name_for(image.string());
+			std::filesystem::remove(cache);
+
+			auto built = process::factory::create(image.string(), true);
+			Assert::IsTrue(std::filesystem::exists(cache));
+			auto loaded = process::factory::create(image.string(), true);
+
+			Assert::IsTrue(loaded->code.hash() == built->code.hash());
+			Assert::IsTrue(loaded->code.find_last() == built->code.find_last());
+			Assert::IsTrue(loaded->verification->verified());
+			Assert::IsTrue(loaded->verification->reachable_instructions() == built->verification->reachable_instructions());
+
+			loaded->input = std::make_unique<std::vector<int64_t>>();
+			loaded->output = std::make_unique<std::vector<int64_t>>();
+			loaded->binary_file_name = get_path("crc.bin");
+			loaded->start();
+			Assert::IsTrue((*loaded->output)[0] == 0x08407759b);
+
+			// the key covers the bytes past the last whole word as well
+			std::vector<uint8_t> bytes(13, 1);
+			const auto hash = image_cache::image_hash(bytes.data(), bytes.size());
+			bytes.back() = 2;
+			Assert::IsTrue(image_cache::image_hash(bytes.data(), bytes.size()) != hash);
+
+			built.reset();
+			loaded.reset();
+			std::filesystem::remove(cache);
+			std::filesystem::remove(image);
+		}
+
+		// Test if the shared program decodes every reachable instruction at its address
+		TEST_METHOD(program_decodes_reachable_code)
+		{
+			auto process = process::factory::create(get_path("crc.evm"));
+			const auto& program = *process->decoded_code;
+
+			for (const auto& reachable : process->verification->reachable_code())
+			{
+				const auto& decoded = program.at(reachable.address);
+				Assert::IsTrue(decoded.address == reachable.address);
+				Assert::IsTrue(decoded.instruction.op_code == reachable.instruction.op_code);
+				// the switch loop and the threaded handlers drop the range check of proven targets
+				Assert::IsTrue(decoded.target_verified == process->verification->target_verified(reachable.address));
+				// followed by the next instruction of its block or the block_link to it
+				Assert::IsTrue((&decoded + 1)->address == reachable.address + reachable.instruction.length);
+			}
+			Assert::IsTrue(program.at(static_cast<uint32_t>(program.size())).instruction.op_code == padding);
+
+			process.reset();
+		}
+
+		// Test if running math.evm with the threaded engine gives expected results
+		TEST_METHOD(run_math_threaded)
+		{
+			auto process = process::factory::create(get_path("math.evm"));
+			process->engine = dispatch_engine::threaded;
+			process->output = std::make_shared<std::vector<int64_t>>();
+			
+			process->start();
+
+			const std::vector<int64_t> validOutput = { 0x118, 0xe8, 0xa, 0x10, 0x1800, 0x1 };
+
+			Assert::IsTrue(*process->output == validOutput);
+			
+			process.reset();
+		}
+
 		// Test if running Memory.evm gives expected results
 		TEST_METHOD(run_memory)
 		{
@@ -183,6 +297,27 @@ namespace tests
 			process.reset();
 		}
 
+		// Test if running fibonacci_loop.evm with hot blocks translated by the jit gives expected results
+		TEST_METHOD(test_fibonacci_jit)
+		{
+			auto reference = process::factory::create(get_path("fibonacci_loop.evm"));
+			reference->input = std::make_unique<std::vector<int64_t>>(1, 92);
+			reference->output = std::make_unique<std::vector<int64_t>>();
+			reference->start();
+
+			auto process = process::factory::create(get_path("fibonacci_loop.evm"));
+			process->engine = dispatch_engine::jit;
+			process->input = std::make_unique<std::vector<int64_t>>(1, 92);
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+
+			Assert::AreEqual(static_cast<size_t>(92), process->output->size());
+			Assert::IsTrue(*process->output == *reference->output);
+
+			process.reset();
+			reference.reset();
+		}
+
 		static uint64_t rand64()
 		{
 			int64_t r = RAND_MAX;
@@ -223,6 +358,31 @@ namespace tests
 			}
 		}
 
+		// Test if running xor.evm with hot blocks translated by the jit gives expected results
+		TEST_METHOD(run_100_xor_jit)
+		{
+			srand(time(nullptr));
+			for (auto i = 0; i < 100; i++)
+			{
+				auto process = process::factory::create(get_path("xor.evm"));
+				process->engine = dispatch_engine::jit;
+
+				const auto number1 = rand64();
+				const auto number2 = rand64();
+				const int64_t valid_xor = number1 ^ number2;
+
+				process->input = std::make_unique<std::vector<int64_t>>();
+				process->output = std::make_unique<std::vector<int64_t>>();
+				process->input->push_back(number1);
+				process->input->push_back(number2);
+				process->start();
+
+				Assert::IsTrue((*process->output)[0] == valid_xor);
+
+				process.reset();
+			}
+		}
+
 		// Test if running xor-with-stack-frame.evm gives expected results
 		TEST_METHOD(run_100_xor_with_stack_frame)
 		{
@@ -264,6 +424,148 @@ namespace tests
 			process.reset();
 		}
 
+		// Test if running crc.evm with the threaded engine gives expected results
+		TEST_METHOD(test_crc_threaded)
+		{
+			auto process = process::factory::create(get_path("crc.evm"));
+			process->engine = dispatch_engine::threaded;
+			process->input = std::make_unique<std::vector<int64_t>>();
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->binary_file_name = get_path("crc.bin");
+			
+			process->start();
+
+			const int64_t computed_crc = (*process->output)[0];
+			Assert::IsTrue(computed_crc == 0x08407759b);
+
+			process.reset();
+		}
+
+		// Test if superinstructions give the results of the instructions they replace and the pushN/popN helpers get one
+		TEST_METHOD(fused_handlers_match_unfused)
+		{
+			const std::vector<std::pair<std::string, std::vector<int64_t>>> samples = {
+				{ "math.evm", {} }, { "Memory.evm", {} }, { "crc.evm", {} }, { "fibonacci_loop.evm", { 92 } },
+				{ "xor-with-stack-frame.evm", { 5, 7 } }, { "threadingBase.evm", {} }, { "lock.evm", {} } };
+			for (const auto& [name, input] : samples)
+			{
+				std::vector<int64_t> outputs[2];
+				for (const auto fused : { false, true })
+				{
+					auto process = process::factory::create(get_path(name));
+					process->decoded_code = program::factory::create(process->code, process->verification, fused);
+					process->engine = dispatch_engine::threaded;
+					process->input = std::make_shared<std::vector<int64_t>>(input);
+					process->output = std::make_shared<std::vector<int64_t>>();
+					if (name == "crc.evm")
+						process->binary_file_name = get_path("crc.bin");
+					process->start();
+					outputs[fused] = *process->output;
+					process.reset();
+				}
+				Assert::IsTrue(!outputs[true].empty() && outputs[false] == outputs[true]);
+			}
+
+			// pushN: loadConst, add, mov, ret - popN: loadConst, mov, sub, ret
+			const std::vector<std::vector<evm2_op_code>> helpers = { { load_const, add, mov, ret }, { load_const, mov, sub, ret } };
+			auto process = process::factory::create(get_path("crc.evm"));
+			const auto& program = *process->decoded_code;
+			const auto& reachable = process->verification->reachable_code();
+			size_t helpers_found = 0;
+			for (size_t i = 0; i + 4 <= reachable.size(); i++)
+				for (const auto& helper : helpers)
+					if (std::equal(helper.begin(), helper.end(), reachable.begin() + i,
+						[](auto op_code, const auto& instruction) { return instruction.instruction.op_code == op_code; }))
+					{
+						Assert::IsTrue(threaded_engine::is_fused(program.at(reachable[i].address).handler));
+						helpers_found++;
+					}
+			Assert::IsTrue(helpers_found > 0);
+			process.reset();
+		}
+
+		// Test if running crc.evm with hot blocks translated by the jit gives expected results
+		TEST_METHOD(test_crc_jit)
+		{
+			auto process = process::factory::create(get_path("crc.evm"));
+			process->engine = dispatch_engine::jit;
+			process->input = std::make_unique<std::vector<int64_t>>();
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->binary_file_name = get_path("crc.bin");
+			
+			process->start();
+
+			const int64_t computed_crc = (*process->output)[0];
+			Assert::IsTrue(computed_crc == 0x08407759b);
+
+			process.reset();
+		}
+
+		// Test if every sample gives the same output, file and fault with hot blocks translated by the jit
+		TEST_METHOD(samples_match_with_jit)
+		{
+			// console input of the samples which read some
+			const std::vector<std::pair<std::string, std::vector<int64_t>>> inputs = {
+				{ "fibonacci_loop.evm", { 92 } }, { "xor.evm", { 5, 7 } }, { "xor-with-stack-frame.evm", { 5, 7 } } };
+			const auto file_name = (std::filesystem::temp_directory_path() / "evm2_jit_sample_test.bin").string();
+			const auto samples = std::filesystem::path(get_path("math.evm")).parent_path();
+
+			for (const auto& sample : std::filesystem::directory_iterator(samples))
+			{
+				// pseudorandom.evm's output depends on how its threads interleave, philosophers.evm runs until it's stopped
+				const auto name = sample.path().filename().string();
+				if (sample.path().extension() != ".evm" || name == "pseudorandom.evm" || name == "philosophers.evm")
+					continue;
+
+				const auto input = std::find_if(inputs.begin(), inputs.end(), [&name](const auto& item) { return item.first == name; });
+				std::vector<int64_t> outputs[2];
+				std::string faults[2];
+				uintmax_t file_sizes[2] = {};
+				for (const auto jit : { false, true })
+				{
+					std::filesystem::remove(file_name);
+					auto process = process::factory::create(sample.path().string());
+					process->engine = jit ? dispatch_engine::jit : dispatch_engine::switch_loop;
+					process->input = std::make_shared<std::vector<int64_t>>(input != inputs.end() ? input->second : std::vector<int64_t>());
+					process->output = std::make_shared<std::vector<int64_t>>();
+					process->binary_file_name = name == "crc.evm" ? get_path("crc.bin") : file_name;
+					try
+					{
+						process->start();
+					}
+					catch (const exception& ex)
+					{
+						faults[jit] = ex.message;
+					}
+					outputs[jit] = *process->output;
+					process.reset();
+					if (std::filesystem::exists(file_name))
+						file_sizes[jit] = std::filesystem::file_size(file_name);
+				}
+
+				Assert::IsTrue(outputs[false] == outputs[true]);
+				Assert::IsTrue(faults[false] == faults[true]);
+				Assert::IsTrue(file_sizes[false] == file_sizes[true]);
+			}
+			std::filesystem::remove(file_name);
+		}
+
+		// Test if blocks translated by the jit keep running while other threads get theirs translated
+		TEST_METHOD(test_jit_threads)
+		{
+			for (auto i = 0; i < 10; i++)
+			{
+				auto process = process::factory::create(get_path("jitThreads.evm"));
+				process->engine = dispatch_engine::jit;
+				process->output = std::make_unique<std::vector<int64_t>>();
+				process->start();
+
+				Assert::IsTrue(*process->output == std::vector<int64_t>{ 100 });
+
+				process.reset();
+			}
+		}
+
 		// Test if running threadingBase.evm gives expected results
 		TEST_METHOD(test_threading_base)
 		{
@@ -278,6 +580,97 @@ namespace tests
 
 			process.reset();
 		}
+
+		// Test if crc.evm translates to a module with its entry point bound to the image
+		TEST_METHOD(translate_crc)
+		{
+			auto process = process::factory::create(get_path("crc.evm"));
+			std::ostringstream source;
+			aot_translator::factory::create(process->code)->translate(source);
+
+			// entry point function, its entry and the image the module is bound to
+			const auto text = source.str();
+			Assert::IsTrue(text.find("static int f_0(evm2_aot_context* c, int depth)") != std::string::npos);
+			Assert::IsTrue(text.find("{ 0, f_0 },") != std::string::npos);
+			Assert::IsTrue(text.find(std::to_string(process->code.hash()) + "ull") != std::string::npos);
+
+			process.reset();
+		}
+
+		// Test if modules built from evm2c output give the results of the interpreter, a fault included
+		TEST_METHOD(native_module_matches_interpreter)
+		{
+			const auto run = [this](const std::string& name, const std::vector<int64_t>& input, std::shared_ptr<aot_module> native)
+			{
+				auto process = process::factory::create(get_path(name));
+				process->native = std::move(native);
+				process->input = std::make_shared<std::vector<int64_t>>(input);
+				process->output = std::make_shared<std::vector<int64_t>>();
+				if (name == "crc.evm")
+					process->binary_file_name = get_path("crc.bin");
+
+				// a fault is reported on the console and stops the thread
+				std::ostringstream messages;
+				auto* const console = std::cout.rdbuf(messages.rdbuf());
+				try
+				{
+					process->start();
+				}
+				catch (...)
+				{
+					std::cout.rdbuf(console);
+					throw;
+				}
+				std::cout.rdbuf(console);
+				return std::make_pair(*process->output, messages.str());
+			};
+
+			const std::vector<std::pair<std::string, std::vector<int64_t>>> samples = {
+				{ "math.evm", {} }, { "crc.evm", {} }, { "fibonacci_loop.evm", { 92 } }, { "highAddressOutOfRange.evm", {} } };
+			for (const auto& [name, input] : samples)
+			{
+				std::string module;
+				if (!build_native_module(name, module))
+				{
+					Logger::WriteMessage("No host C++ compiler, native modules not tested");
+					return;
+				}
+
+				const auto image = process::factory::create(get_path(name));
+				const auto interpreted = run(name, input, nullptr);
+				const auto native = run(name, input, aot_module::factory::create(module, image->code));
+				Assert::IsTrue(native == interpreted);
+				Assert::IsTrue(name == "highAddressOutOfRange.evm"
+					? interpreted.second.find("out of range") != std::string::npos
+					: !interpreted.first.empty());
+
+				std::filesystem::remove(module);
+			}
+		}
+
+		// Test if a native loop gives up its worker when its time slice ends
+		TEST_METHOD(native_loop_yields_task)
+		{
+			std::string module;
+			if (!build_native_module("nativeSpin.evm", module))
+			{
+				Logger::WriteMessage("No host C++ compiler, native modules not tested");
+				return;
+			}
+
+			// the main thread sleeps while a native loop runs on the only worker, then ends the process
+			auto process = process::factory::create(get_path("nativeSpin.evm"));
+			process->native = aot_module::factory::create(module, process->code);
+			process->threads = thread_model::tasks;
+			process->workers = 1;
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+
+			Assert::IsTrue(*process->output == std::vector<int64_t>{ 10 });
+
+			process.reset();
+			std::filesystem::remove(module);
+		}
 		
 		// Test if running threadingBase.evm gives expected results
 		TEST_METHOD(stop_1000_threads)
@@ -288,6 +681,69 @@ namespace tests
 			process.reset();
 		}
 
+		// Test if 1000 guest threads run as tasks on a few workers
+		TEST_METHOD(stop_1000_threads_tasks)
+		{
+			auto process = process::factory::create(get_path("stop1000threads.evm"));
+			process->threads = thread_model::tasks;
+			process->workers = 4;
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+			process.reset();
+		}
+
+		// Test if a task woken from its sleep runs while other tasks keep submitting newer ones to the worker
+		TEST_METHOD(woken_task_not_starved)
+		{
+			auto process = process::factory::create(get_path("stopCreateJoinLoop.evm"));
+			process->threads = thread_model::tasks;
+			process->workers = 1;
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+			process.reset();
+		}
+
+		// Test if a create/join loop reuses the slot of the joined thread
+		TEST_METHOD(create_join_loop_reuses_threads)
+		{
+			for (const auto threads : { thread_model::os_threads, thread_model::tasks })
+			{
+				auto process = process::factory::create(get_path("createJoinLoop.evm"));
+				process->threads = threads;
+				process->output = std::make_unique<std::vector<int64_t>>();
+				process->start();
+
+				// 1000 threads, all of them got the id of the first one
+				const int64_t result = (*process->output)[0];
+				Assert::IsTrue(result == 1);
+
+				process.reset();
+			}
+		}
+
+		// Test if the process stops while its threads create and join threads, reusing their slots
+		TEST_METHOD(stop_create_join_loop)
+		{
+			for (const auto threads : { thread_model::os_threads, thread_model::tasks })
+				for (auto i = 0; i < 20; i++)
+				{
+					auto process = process::factory::create(get_path("stopCreateJoinLoop.evm"));
+					process->threads = threads;
+					process->output = std::make_unique<std::vector<int64_t>>();
+					process->start();
+					process.reset();
+				}
+		}
+
+		// Test if threads waiting for a lock held by the main thread end with the process
+		TEST_METHOD(stop_100_lock_waiters)
+		{
+			auto process = process::factory::create(get_path("stop100lockwaiters.evm"));
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+			process.reset();
+		}
+
 		// Test if running lock.evm gives expected results
 		TEST_METHOD(test_lock)
 		{
@@ -301,6 +757,52 @@ namespace tests
 			process.reset();
 		}
 
+		// Test if running lock.evm with the threaded engine gives expected results
+		TEST_METHOD(test_lock_threaded)
+		{
+			auto process = process::factory::create(get_path("lock.evm"));
+			process->engine = dispatch_engine::threaded;
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+
+			const int64_t result = (*process->output)[0];
+			Assert::IsTrue(result == 0x300);
+			
+			process.reset();
+		}
+
+		// Test if running lock.evm as tasks gives expected results
+		TEST_METHOD(test_lock_tasks)
+		{
+			auto process = process::factory::create(get_path("lock.evm"));
+			process->threads = thread_model::tasks;
+			process->workers = 2;
+			process->output = std::make_unique<std::vector<int64_t>>();
+			process->start();
+
+			const int64_t result = (*process->output)[0];
+			Assert::IsTrue(result == 0x300);
+			
+			process.reset();
+		}
+
+		// Test if threads parked on a lock get it in the order they arrived
+		TEST_METHOD(test_lock_handoff_order)
+		{
+			for (const auto threads : { thread_model::os_threads, thread_model::tasks })
+			{
+				auto process = process::factory::create(get_path("lockOrder.evm"));
+				process->threads = threads;
+				process->output = std::make_unique<std::vector<int64_t>>();
+				process->start();
+
+				const std::vector<int64_t> arrival_order = { 1, 2, 3, 4 };
+				Assert::IsTrue(*process->output == arrival_order);
+
+				process.reset();
+			}
+		}
+
 		// Test if running multithreaded_file_write.evm gives expected results
 		TEST_METHOD(test_multithreaded_file_write)
 		{
@@ -320,5 +822,203 @@ namespace tests
 
 			process.reset();
 		}
+
+		// Test if concurrent writes of disjoint ranges all land and overlapping ones are never torn
+		TEST_METHOD(test_concurrent_file_writes)
+		{
+			const auto file_name = (std::filesystem::temp_directory_path() / "evm2_concurrent_write_test.bin").string();
+			std::filesystem::remove(file_name);
+			auto file = binary_file::factory::create(file_name);
+
+			const size_t writers = 8;
+			const size_t block_size = 0x100000;
+			std::vector<std::thread> threads;
+			for (size_t i = 0; i < writers; i++)
+				threads.emplace_back([&file, i]
+				{
+					const std::vector<uint8_t> block(block_size, static_cast<uint8_t>(i + 1));
+					for (auto round = 0; round < 8; round++)
+					{
+						file->write(block_size * (i + 1), block.data(), block.size()); // its own range
+						file->write(0, block.data(), block.size());                    // everyone's range
+					}
+				});
+			for (auto& thread : threads)
+				thread.join();
+
+			std::vector<uint8_t> block(block_size);
+			Assert::IsTrue(file->size() == block_size * (writers + 1));
+			for (size_t i = 0; i <= writers; i++)
+			{
+				Assert::IsTrue(file->read(block_size * i, block.data(), block.size()) == block.size());
+				const auto expected = i ? static_cast<uint8_t>(i) : block[0];
+				Assert::IsTrue(expected >= 1 && expected <= writers);
+				Assert::IsTrue(std::all_of(block.begin(), block.end(), [expected](auto value) { return value == expected; }));
+			}
+
+			file.reset();
+			std::filesystem::remove(file_name);
+		}
+
+		// Test if multithreaded_file_write.evm writes the same file through a mapping
+		TEST_METHOD(test_multithreaded_file_write_mapped)
+		{
+			auto process = process::factory::create(get_path("multithreaded_file_write.evm"));
+			process->output = std::make_unique<std::vector<int64_t>>();
+
+			std::string file_name = "file.bin";
+			process->binary_file_name = file_name;
+			process->map_binary_file = true;
+			if (std::filesystem::exists(file_name))
+				remove(file_name.c_str());
+
+			std::string correctFileName = get_path("multithreaded_file_write.bin");
+
+			process->start();
+
+			Assert::IsTrue(compare_two_small_files_are_equal(file_name, correctFileName));
+
+			process.reset();
+		}
+
+		// Test if a write at 4 GiB pads the file with zeroes without writing them
+		TEST_METHOD(test_high_file_offset_write)
+		{
+			for (const auto mapped : { false, true })
+			{
+				auto process = process::factory::create(get_path("highFileOffset.evm"));
+				process->output = std::make_unique<std::vector<int64_t>>();
+
+				std::string file_name = "file.bin";
+				process->binary_file_name = file_name;
+				process->map_binary_file = mapped;
+				if (std::filesystem::exists(file_name))
+					remove(file_name.c_str());
+
+				process->start();
+
+				// a qword read from the gap and the one written
+				Assert::IsTrue((*process->output)[0] == 0);
+				Assert::IsTrue((*process->output)[1] == 0x1122334455667788);
+				Assert::IsTrue(std::filesystem::file_size(file_name) == 0x100000008);
+
+				process.reset();
+				remove(file_name.c_str());
+			}
+		}
+
+		// Test if a write whose end wraps past 2^64 is refused instead of reaching the file or its mapping
+		TEST_METHOD(test_wrapped_file_offset_write)
+		{
+			const auto file_name = (std::filesystem::temp_directory_path() / "evm2_wrapped_write_test.bin").string();
+			for (const auto mapped : { false, true })
+			{
+				std::filesystem::remove(file_name);
+				auto refused = false;
+				{
+					const auto file = binary_file::factory::create(file_name, mapped);
+					const std::vector<uint8_t> data(16, 0x5a);
+					try
+					{
+						file->write(UINT64_MAX - 7, data.data(), data.size());
+					}
+					catch (const exception&)
+					{
+						refused = true;
+					}
+					Assert::IsTrue(refused);
+					Assert::IsTrue(file->size() == 0);
+				}
+
+				// a negative register as the offset, the main thread faults before the consoleWrite
+				for (const auto engine : { dispatch_engine::switch_loop, dispatch_engine::threaded })
+				{
+					auto process = process::factory::create(get_path("wrappedFileOffset.evm"));
+					process->engine = engine;
+					process->output = std::make_unique<std::vector<int64_t>>();
+					process->binary_file_name = file_name;
+					process->map_binary_file = mapped;
+					refused = false;
+					try
+					{
+						process->start();
+					}
+					catch (const out_of_range_exception&)
+					{
+						refused = true;
+					}
+
+					Assert::IsTrue(refused);
+					Assert::IsTrue(process->output->empty());
+					process.reset();
+					Assert::IsTrue(std::filesystem::file_size(file_name) == 0);
+				}
+			}
+			std::filesystem::remove(file_name);
+		}
+
+		// Test if reads see buffered writes and a direct write isn't overwritten by an older pending run
+		TEST_METHOD(test_buffered_file_write_coherence)
+		{
+			const auto file_name = (std::filesystem::temp_directory_path() / "evm2_buffered_write_test.bin").string();
+			std::filesystem::remove(file_name);
+
+			const size_t direct_size = 0x100000; // binary_file::max_pending, written directly
+			const std::vector<uint8_t> small(8, 0x11);
+			const std::vector<uint8_t> large(direct_size, 0x22);
+			std::vector<uint8_t> read(direct_size);
+			{
+				auto file = binary_file::factory::create(file_name);
+				file->write(0, small.data(), small.size());
+				Assert::IsTrue(file->read(0, read.data(), small.size()) == small.size());
+				Assert::IsTrue(std::equal(small.begin(), small.end(), read.begin()));
+
+				// pending again at the offset of the direct write
+				file->write(0, small.data(), small.size());
+				file->write(0, large.data(), large.size());
+				file->flush();
+				Assert::IsTrue(file->read(0, read.data(), read.size()) == read.size());
+				Assert::IsTrue(read == large);
+			}
+
+			auto reopened = binary_file::factory::create(file_name);
+			Assert::IsTrue(reopened->size() == direct_size);
+			Assert::IsTrue(reopened->read(0, read.data(), read.size()) == read.size());
+			Assert::IsTrue(read == large);
+			reopened.reset();
+			std::filesystem::remove(file_name);
+		}
+
+		// Test if console output writes the values as 16 digit hex lines on flush
+		TEST_METHOD(test_console_output)
+		{
+			std::ostringstream stream;
+			console_output console(stream);
+			console.write(0x1f);
+			console.write(0xfedcba9876543210);
+			Assert::IsTrue(stream.str().empty());
+
+			console.flush();
+			Assert::IsTrue(stream.str() == "000000000000001f\nfedcba9876543210\n");
+		}
+
+		// Test if the fault message of a thread follows the console output written before the fault
+		TEST_METHOD(test_fault_message_after_output)
+		{
+			std::stringstream stream;
+			auto* const original = std::cout.rdbuf(stream.rdbuf());
+			auto process = process::factory::create(get_path("faultAfterOutput.evm"));
+			process->start();
+			process.reset();
+			std::cout.rdbuf(original);
+
+			std::vector<std::string> lines;
+			for (std::string line; std::getline(stream, line);)
+				lines.push_back(line);
+			Assert::IsTrue(lines.size() == 5);
+			Assert::IsTrue(lines[0] == "0000000000000001" && lines[1] == "0000000000000001");
+			Assert::IsTrue(lines[3] == "Thread has been stopped");
+			Assert::IsTrue(lines[4] == "0000000000000002");
+		}
 	};
 }